@@ -8,22 +8,30 @@
 #include "beefit.h"
 
 
+// the least a chunk has for -P, so it's still worth optimizing alone
+#define CHUNK_SIZE 1024
+// how long -O picks passes for, unless -B says otherwise
+#define DEFAULT_BUDGET 100
+
 void usage(char *name) {
-  fprintf(stderr, "usage: %s [-d]/[-t]/[-s] [filename]\n", name);
+  fprintf(stderr, "usage: %s [-d]/[-t]/[-s]/[-b]/[-H]/[-C]/[-I]/[-T]/[-L]/[-P] [-O 0|1|2] [-B ms] [-X pass]... [-p folded] [-A count] [filename]\n", name);
+  fprintf(stderr, "passes: ");
+  print_passes(stderr);
   exit(1);
 }
 
 int main(int argc, char *argv[]) {
   FILE *in = stdin;
 
-  if (argc > 3) {
-    usage(argv[0]);
-  }
-
   int stats = 0;
+  char *folded_name = NULL;  // for -p
+  int compiles = 0;          // for -A
+
+  opt_level = OPT_AUTO;
+  opt_budget = -1;
 
   int opt;
-  while ((opt = getopt(argc, argv, "dths")) != -1) {
+  while ((opt = getopt(argc, argv, "dthsbHCITLPO:B:X:p:A:")) != -1) {
     switch (opt) {
       case 'd':
         debug = 1;
@@ -35,12 +43,60 @@ int main(int argc, char *argv[]) {
       case 's':
         stats = 1;
         break;
+      case 'b':
+        safe = 1;
+        break;
+      case 'H':
+        hugepages = 1;
+        break;
+      case 'C':
+        cbackend = 1;
+        break;
+      case 'I':
+        interp = 1;
+        break;
+      case 'T':
+        tiered = 1;
+        break;
+      case 'L':
+        lazy = 1;
+        break;
+      case 'P':
+        pipelined = 1;
+        break;
+      case 'O':
+        if (optarg[0] < '0' || optarg[0] > '2' || optarg[1])
+          usage(argv[0]);
+        opt_level = optarg[0] - '0';
+        break;
+      case 'B':
+        opt_budget = atoi(optarg);
+        if (opt_budget < 0)
+          usage(argv[0]);
+        break;
+      case 'p':
+        profiling = 1;
+        folded_name = optarg;
+        break;
+      case 'A':
+        compiles = atoi(optarg);
+        if (compiles <= 0)
+          usage(argv[0]);
+        break;
+      case 'X':
+        if (!disable_pass(optarg)) {
+          fprintf(stderr, "error: no pass named %s\n", optarg);
+          usage(argv[0]);
+        }
+        break;
       case 'h':
         usage(argv[0]);
         break;
     }
   }
-  if (optind < argc) {
+  if (optind < argc - 1) {
+    usage(argv[0]);
+  } else if (optind < argc) {
     in = fopen(argv[optind], "r");
     if (!in) {
       perror("unable to open file");
@@ -48,46 +104,104 @@ int main(int argc, char *argv[]) {
     }
   }
 
+  // -T, -L and -P don't apply to the other backends, or to dumps of
+  // the code, and only one of them can change how it's compiled
+  if (cbackend || interp || debug)
+    tiered = lazy = pipelined = 0;
+  // -A times the JIT's compiles of the whole program, and nothing else
+  if (compiles)
+    cbackend = interp = tiered = lazy = pipelined = profiling = 0;
+  if (pipelined)
+    tiered = lazy = 0;
+  if (tiered)
+    lazy = 0;
+  // a level given by hand is done in full, unless -B limits it too
+  if (opt_budget < 0)
+    opt_budget = opt_level == OPT_AUTO ? DEFAULT_BUDGET : 0;
+  if (pipelined)
+    pipeline_start();
+
   int limit = 1 << 16;
   int count = 0;
   int loop_depth = 0;
   int loop_count = 0;
-  ins_t *code = malloc(limit * sizeof(ins_t));
-  code[0] = (ins_t){OP_EOF, 0, 0};
+  int chunk_start = 0;  // for -P
+  // room for the OP_EOF on either side
+  ins_t *code = malloc((limit + 1) * sizeof(ins_t));
+  code[0] = INS(OP_EOF, 0, 0);
   code++;
+  // -p keeps the source to show the loops it finds
+  char *source = NULL;
+  size_t source_len = 0, source_limit = 0;
   char c;
   while ((c = getc(in)) != EOF) {
+    if (profiling) {
+      if (source_len == source_limit) {
+        source_limit = source_limit ? source_limit * 2 : 1 << 16;
+        source = realloc(source, source_limit);
+        if (!source) {
+          perror("unable to allocate the source");
+          return 1;
+        }
+      }
+      source[source_len] = c;
+    }
+    source_len++;
     ins_t ins;
     ins.op = OP_NOP;
     switch (c) {
-      case '+': ins = (ins_t){OP_ADD, 1, 0};    break;
-      case '-': ins = (ins_t){OP_ADD, -1, 0};   break;
-      case '>': ins = (ins_t){OP_SHIFT, 0, 1};  break;
-      case '<': ins = (ins_t){OP_SHIFT, 0, -1}; break;
-      case '[': ins = (ins_t){OP_SKIPZ, 0, 0};
+      case '+': ins = INS(OP_ADD, 1, 0);    break;
+      case '-': ins = INS(OP_ADD, -1, 0);   break;
+      case '>': ins = INS(OP_SHIFT, 0, 1);  break;
+      case '<': ins = INS(OP_SHIFT, 0, -1); break;
+      case '[': ins = INS(OP_SKIPZ, 0, 0);
         loop_depth++;
         loop_count++;
         break;
-      case ']': ins = (ins_t){OP_LOOPNZ, 0, 0};
+      case ']': ins = INS(OP_LOOPNZ, 0, 0);
         if (--loop_depth < 0) {
           fprintf(stderr, "error: unmatched ]\n");
           exit(1);
         }
         break;
-      case '.': ins = (ins_t){OP_PRINT, 0, 0};  break;
-      case ',': ins = (ins_t){OP_READ, 0, 0};   break;
+      case '.': ins = INS(OP_PRINT, 0, 0);  break;
+      case ',': ins = INS(OP_READ, 0, 0);   break;
     }
     if (ins.op != OP_NOP) {
+      ins.src = source_len;
       code[count++] = ins;
+      if (pipelined && ins.op == OP_LOOPNZ && !loop_depth &&
+          count - chunk_start >= CHUNK_SIZE) {
+        // a top-level loop just ended, so everything since the last
+        // chunk can be compiled while the rest is read
+        pipeline_chunk(code + chunk_start, count - chunk_start);
+        chunk_start = count;
+      }
       if (count >= limit) {
         limit *= 2;
-        code = realloc(code, limit * sizeof(ins_t));
+        code = realloc(code - 1, (limit + 1) * sizeof(ins_t));
+        if (!code) {
+          perror("unable to allocate code");
+          return 1;
+        }
+        code++;
       }
     }
   }
-  code[count] = (ins_t){OP_EOF, 0, 0};
+  if (loop_depth) {
+    fprintf(stderr, "error: unmatched [\n");
+    exit(1);
+  }
+  code[count] = INS(OP_EOF, 0, 0);
 
-  int opt_size = optimize(code);
+  int size = 0, opt_size;
+  bf_ptr fptr = NULL;
+  double opt_start = now_ms();
+  if (pipelined)
+    fptr = pipeline_finish(code + chunk_start, count - chunk_start, &opt_size, &size);
+  else
+    opt_size = tiered ? optimize_baseline(code) : optimize(&code);
+  double opt_time = now_ms() - opt_start;
 
   if (trace) {
     trace_counts = calloc(loop_count, sizeof(uint32_t));
@@ -95,29 +209,125 @@ int main(int argc, char *argv[]) {
     print_code(code, opt_size);
   }
 
-  int size;
-  bf_ptr fptr = assemble(code, &size);
+  if (cbackend)
+    fptr = assemble_c(code, &size);
+  else if (tiered)
+    fptr = tier_start(code, &size);
+  else if (!interp && !pipelined)
+    fptr = assemble(code, &size);
+  if (compiles) {
+    // compiles per second, each released again as a long-running
+    // host would, without running the program
+    if (!fptr) {
+      fprintf(stderr, "error: no executable memory\n");
+      return 1;
+    }
+    release(fptr, size);
+    double start = now_ms();
+    for (int i = 0; i < compiles; i++) {
+      fptr = assemble(code, &size);
+      if (!fptr) {
+        fprintf(stderr, "error: no executable memory\n");
+        return 1;
+      }
+      release(fptr, size);
+    }
+    printf("compiles/s:%.0f\n", compiles / (now_ms() - start) * 1000);
+    return 0;
+  }
+  if (!fptr && !interp && (debug || stats))
+    fprintf(stderr, "no executable memory, interpreting\n");
+  if (!fptr && tiered)
+    opt_size = optimize(&code);
 
   if (debug || stats) {
-    printf("ins:%d opt:%d x86:%dB\n", count, opt_size, size);
+    // -T and -P pick a level for each piece they optimize
+    printf("ins:%d opt:%d x86:%dB ", count, opt_size, size);
+    if (opt_level != OPT_AUTO)
+      printf("level:%d ", opt_level);
+    else if (!tiered && !pipelined)
+      printf("level:%d ", choose_level(count));
+    else
+      printf("level:auto ");
+    printf("opt-time:%.1fms\n", opt_time);
   }
 
   // TODO: calculate padding precisely
-  uint8_t *buf = calloc(1 << 16, 1);
-  fptr(buf + 1000);
+  uint8_t *buf = alloc_pages(TAPE_SIZE + TAPE_SLACK, hugepages);
+  if (!buf) {
+    perror("unable to allocate tape");
+    return 1;
+  }
+
+  if (stats) {
+    perf_begin();
+  }
+  if (profiling)
+    profile_start();
+  if (fptr)
+    fptr(buf + 1000, buf);
+  else
+    interpret(code, buf + 1000, buf);
+  if (profiling)
+    profile_stop();
+  if (stats) {
+    perf_end();
+    fflush(stdout);
+    perf_print();
+  }
+  if (tiered)
+    tier_end();
+
+  if (profiling) {
+    fflush(stdout);
+    FILE *folded = fopen(folded_name, "w");
+    if (!folded)
+      perror("unable to write the profile's stacks");
+    char *name = optind < argc ? strrchr(argv[optind], '/') : NULL;
+    name = name ? name + 1 : optind < argc ? argv[optind] : "stdin";
+    profile_report(stderr, folded, name, source, source_len);
+    if (folded)
+      fclose(folded);
+    free(source);
+  }
 
   if (trace) {
     print_code(code, opt_size);
     free(trace_counts);
   }
 
-  free(buf);
+  free_pages(buf, TAPE_SIZE + TAPE_SLACK, hugepages);
   free(code - 1);
-  munmap(fptr, size);
+  if (pipelined)
+    pipeline_release();
+  else if (cbackend)
+    release_c(fptr, size);
+  else if (fptr)
+    release(fptr, size);
+  if (lazy)
+    lazy_release();
 
   return 0;
 }
 
+char *tmp(ins_t *code) {
+  // the name of the temporary an op uses
+  static char buf[8];
+  if (!code->t)
+    return "tmp";
+  snprintf(buf, sizeof(buf), "tmp%d", code->t);
+  return buf;
+}
+
+char *cell(ins_t *code) {
+  // the cell a loop tests, when it isn't the current one
+  static char buf[16];
+  buf[0] = 0;
+  if (code->b && code->a != 2)
+    snprintf(buf, sizeof(buf), " *%d", code->b);
+  return buf;
+}
+
 void print_code(ins_t *code, int count) {
   int indent = 0;
   int loop_count = 0;
@@ -132,43 +342,52 @@ void print_code(ins_t *code, int count) {
       case OP_ADDT:
         printf("%*s*%d ", indent, "", code->b);
         if (code->a == 1) {
-          printf("+= tmp\n");
+          printf("+= %s\n", tmp(code));
         } else if (code->a == -1) {
-          printf("-= tmp\n");
+          printf("-= %s\n", tmp(code));
         } else {
-          printf("+= tmp*%d\n", code->a);
+          printf("+= %s*%d\n", tmp(code), code->a);
         }
         break;
       case OP_SET:
         printf("%*s*%d = %d\n", indent, "", code->b, code->a);
         break;
       case OP_SETT:
-        printf("%*s*%d = tmp\n", indent, "", code->b);
+        printf("%*s*%d = %s\n", indent, "", code->b, tmp(code));
         break;
       case OP_TADD: {
          int off = (int8_t)((code->a & 0x7f) | ((code->a & 0x40) << 1));
           if (code->a & 0x80) {
             if (off)
-              printf("%*stmp = *%d - tmp %+d\n", indent, "", code->b, off);
+              printf("%*s%s = *%d - %s %+d\n", indent, "", tmp(code), code->b, tmp(code), off);
             else
-              printf("%*stmp = *%d - tmp\n", indent, "", code->b);
+              printf("%*s%s = *%d - %s\n", indent, "", tmp(code), code->b, tmp(code));
           } else {
             if (off)
-              printf("%*stmp += *%d %+d\n", indent, "", code->b, off);
+              printf("%*s%s += *%d %+d\n", indent, "", tmp(code), code->b, off);
             else
-              printf("%*stmp += *%d\n", indent, "", code->b);
+              printf("%*s%s += *%d\n", indent, "", tmp(code), code->b);
           }
         }
         break;
+      case OP_MULT:
+        printf("%*s%s *= *%d\n", indent, "", tmp(code), code->b);
+        break;
+      case OP_CMP:
+        printf("%*s%s = %s < *%d\n", indent, "", tmp(code), tmp(code), code->b);
+        break;
       case OP_LOAD:
         if (code->a) {
-          printf("%*stmp = *%d + %d\n", indent, "", code->b, code->a);
+          printf("%*s%s = *%d + %d\n", indent, "", tmp(code), code->b, code->a);
         } else {
-          printf("%*stmp = *%d\n", indent, "", code->b);
+          printf("%*s%s = *%d\n", indent, "", tmp(code), code->b);
         }
         break;
       case OP_SKIPZ:
-        printf("%*s%c\n", indent, "", code->a ? '{' : '[');
+        if (code->a == 2)
+          printf("%*srepeat %d {\n", indent, "", code->b);
+        else
+          printf("%*s%c%s\n", indent, "", code->a ? '{' : '[', cell(code));
         indent += 2;
         if (trace) {
           printf("%*sLC: %d #%d\n", indent, "", trace_counts[loop_count], loop_count);
@@ -177,7 +396,22 @@ void print_code(ins_t *code, int count) {
         break;
       case OP_LOOPNZ:
         indent -= 2;
-        printf("%*s%c\n", indent, "", code->a ? '}' : ']');
+        printf("%*s%c%s\n", indent, "", code->a ? '}' : ']', cell(code));
+        break;
+      case OP_MOVE:
+        printf("%*smove run by %d\n", indent, "", code->a);
+        break;
+      case OP_CAT:
+        printf("%*secho *%d until %d\n", indent, "", code->b, (uint8_t)-code->a);
+        break;
+      case OP_DIVMOD:
+        printf("%*sdivmod *%d by *%d\n", indent, "", code->b, code->b + code->a + 1);
+        break;
+      case OP_CARRY:
+      case OP_BORROW:
+        printf("%*s*%d..*%d %c= *%d\n", indent, "", code->b + code->a,
+               code->b + code->a + code->t - 1,
+               code->op == OP_CARRY ? '+' : '-', code->b);
         break;
       case OP_PRINT:
         printf("%*sprint *%d\n", indent, "", code->b);
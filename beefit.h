@@ -4,7 +4,9 @@
 #define STATIC_ASSERT( condition, name )\
     typedef char assert_failed_ ## name [ (condition) ? 1 : -1 ];
 
+#include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
 typedef enum {
   // optimizations to edit with new opcodes:
@@ -18,28 +20,157 @@ typedef enum {
   OP_ADDT,    // ptr[b] += tmp * (int8_t)a
   OP_LOAD,    // tmp = ptr[b] + a
   OP_TADD,    // tmp = tmp*(a>>8) + ptr[b] + (a&0x7f)
-  OP_SKIPZ,   // if (a || ptr[b]) do {
-  OP_LOOPNZ,  // } while (ptr[b] && !a)
+  OP_MULT,    // tmp *= ptr[b]
+  OP_CMP,     // tmp = tmp < ptr[b]
+  OP_SKIPZ,   // if (a || ptr[b]) do {      a == 2: for (n = b; n; n--) {
+  OP_LOOPNZ,  // } while (ptr[b] && !a)    a == 2: }
+  OP_MOVE,    // while (ptr[0]) { ptr[a] += ptr[0]; ptr[0] = 0; ptr -= sign(a); }
+  OP_DIVMOD,  // the divmod loop after it, at once when it stays in place
+  OP_CARRY,   // the loop after it adding ptr[b] to the t cells at b+a, at once
+  OP_BORROW,  // the same loop subtracting, a cell borrowing when it gets to 0
+  OP_CAT,     // the echo loop after it, up to the byte -a or EOF
   OP_PRINT,   // putchar(ptr[b])
   OP_READ,    // ptr[b] = getchar()
   OP_EOF      // end of instructions
 } ins_op_t;
 
 typedef struct {
-  ins_op_t op;
+  ins_op_t op : 5;
+  uint8_t t : 3;  // which temporary the tmp ops use
   int8_t a;
   int16_t b;
+  // 1 + where in the source the op comes from, for -p, or 0 when a
+  // pass made it up: then it's from wherever the op before it is
+  uint32_t src;
 } ins_t;
 
-STATIC_ASSERT(sizeof(ins_t) == sizeof(uint32_t), packed_opcodes);
+STATIC_ASSERT(sizeof(ins_t) == 2 * sizeof(uint32_t), packed_opcodes);
 
-typedef void (*bf_ptr)(uint8_t*);
+// an instruction on the first temporary
+#define INS(op, a, b) ((ins_t){(op), 0, (a), (b), 0})
 
-int optimize(ins_t *code);
+// the a of the OP_EOF in front of code that's only part of a program
+#define MID_START 1  // it doesn't start the program
+#define MID_END 2    // or doesn't end it
+
+// temporaries that get their own registers
+#define NUM_TEMPS 4
+
+#define TAPE_SIZE (1 << 16)
+#define TAPE_SLACK 16  // vector ops may touch cells this far past the end
+#define HUGE_PAGE_SIZE (2 << 20)
+
+// called with the initial cell and the start of the tape,
+// returns where the pointer ended up
+typedef uint8_t *(*bf_ptr)(uint8_t *ptr, uint8_t *tape);
+
+// -O: 0 only folds and condenses, 1 adds the passes that repeat until
+// nothing changes, and 2 the ones that can grow the code. OPT_AUTO
+// picks the most that fits in opt_budget milliseconds by the code's size.
+#define OPT_AUTO -1
+int optimize(ins_t **code);
+int optimize_baseline(ins_t *code);
+int choose_level(int size);
+double now_ms();
+// -X: returns 0 for a pass that doesn't exist
+int disable_pass(const char *name);
+void print_passes(FILE *out);
 void print_code(ins_t *code, int count);
 
 bf_ptr assemble(ins_t *code, int *size_out);
+// entries, if set, has a slot per loop that the code polls at the
+// loop's back-edge, and calls to finish the loop once it's filled.
+// the code stores the number of each loop it enters in current.
+bf_ptr assemble_tiered(ins_t *code, bf_ptr *entries, int *current, int *size_out);
+void release(bf_ptr fptr, int size);
+
+// two tiers for -T: baseline code while the loops are optimized
+bf_ptr tier_start(ins_t *code, int *size_out);
+void tier_end();
+
+// -L: big loops are compiled on their first entry. the code calls
+// a loop through its stub's fptr once it's set, lazy_enter before.
+typedef struct stub {
+  bf_ptr fptr;
+  ins_t *code;  // the loop's own copy
+  int size;
+  struct stub *next;
+} stub_t;
+stub_t *lazy_stub(ins_t *code, int n);
+uint8_t *lazy_enter(uint8_t *ptr, uint8_t *tape, stub_t *stub);
+void lazy_release();
+
+// -P: chunks of the program are compiled by other threads as
+// they're read, and the function returned runs them in order
+void pipeline_start();
+void pipeline_chunk(ins_t *code, int n);
+bf_ptr pipeline_finish(ins_t *code, int n, int *opt_size, int *size_out);
+void pipeline_release();
+
+// -p: the emitter labels each op's code with its place in the
+// source and the loops around it there, and the labels become
+// addresses once the code is placed in memory
+typedef struct {
+  uintptr_t addr;
+  uint32_t src;
+  int loop;  // in the block's loops, or -1
+} prof_op_t;
+typedef struct {
+  uint32_t start, end;  // where the loop's [ and ] are
+  int parent;
+} prof_loop_t;
+typedef struct prof_block {
+  uintptr_t start, end;
+  prof_op_t *ops;
+  prof_loop_t *loops;
+  int num_ops, num_loops;
+  int *hits;
+  struct prof_block *next;
+} prof_block_t;
+prof_block_t *prof_block();
+void prof_op(prof_block_t *block, uintptr_t label, uint32_t src, int loop);
+int prof_loop(prof_block_t *block, uint32_t start, int parent);
+void prof_place(prof_block_t *block, void *code, size_t size);
+void prof_free(prof_block_t *block);
+void profile_start();
+void profile_stop();
+// a flat profile of the loops to out, and the stacks to folded if set
+void profile_report(FILE *out, FILE *folded, const char *name,
+                    const char *source, size_t len);
+
+// the same through the system C compiler, for -C
+bf_ptr assemble_c(ins_t *code, int *size_out);
+void release_c(bf_ptr fptr, int size);
+
+// the threaded interpreter, for -I or without executable memory
+uint8_t *interpret(ins_t *code, uint8_t *ptr, uint8_t *tape);
+
+// runtime helpers the generated code calls
+void tape_overflow(intptr_t cell);
+uint8_t *move_cells(uint8_t *ptr, uint8_t *tape, int off);
+uint8_t echo_cells(uint8_t cell, int add);
+
+void *alloc_pages(size_t size, int huge);
+void free_pages(void *mem, size_t size, int huge);
+void *alloc_code(size_t size, int huge, void **writable);
+int seal_code(void *code, size_t size, int huge);
+void free_code(void *code, size_t size, int huge);
+
+void perf_begin();
+void perf_end();
+void perf_print();
 
 int debug;
 int trace;
+int safe;
+int hugepages;
+int cbackend;
+int interp;
+int tiered;
+int lazy;
+int pipelined;
+int opt_level;
+int opt_budget;  // ms, or 0 for none
+uint32_t disabled_passes;
+int profiling;
 uint32_t *trace_counts;
@@ -0,0 +1,206 @@
+#!/usr/bin/env python
+# Compare the JIT with the C backend (-C) and the interpreter (-I)
+# on everything in bench/. Times are the best of a few runs of the
+# program itself, from -s, so the C compiler's time isn't counted.
+#
+# With --ablate, run bench/ and test/ with each optimization pass
+# turned off in turn (-X), and print the run times and code sizes.
+#
+# With --first-byte, time bench/ from starting beefit to the first
+# byte of output and to the end, with and without -T. The output goes
+# to a terminal, so it comes line by line as it would for a user.
+#
+# With --compile, print how many times a second beefit assembles each
+# program in bench/ and test/ once it's optimized (-A), without running it.
+
+from __future__ import print_function
+
+import os
+import pty
+import re
+import subprocess
+import sys
+import tempfile
+import time
+
+RUNS = 3
+
+backends = [('jit', []), ('cc', ['-C']), ('interp', ['-I'])]
+
+
+def read(fname):
+    with open(fname, 'rb') as f:
+        return f.read()
+
+
+inputs = {
+    'bench/awib.bf': lambda: b'@386_linux\n' + read('bench/awib.bf'),
+    'bench/dbfi.bf': lambda: read('bench/dbfi.bf') + b'!' + read('test/echo9.bf') + b'!hello123\n',
+    'bench/factor.bf': lambda: b'133333333333337\n',
+    'test/awib.bf': lambda: read('test/fizzbuzz.bf'),
+    'test/bfcl.bf': lambda: read('test/fizzbuzz.bf'),
+    'test/bfi.bf': lambda: read('test/hello.bf') + b'!',
+    'test/cat.bf': lambda: b'first line\nsecond\nthird\n',
+    'test/divmod.bf': lambda: b'Az\x01\xff',
+    'test/echo9.bf': lambda: b'hello123\n',
+    'test/move.bf': lambda: b'hello world\n',
+    'test/vector.bf': lambda: b'\x07',
+}
+
+
+def run(filename, flags, stdin):
+    # the best time, the size of the code and the output, or Nones
+    best = size = output = None
+    for _ in range(RUNS):
+        p = subprocess.Popen(['./beefit', '-s'] + flags + [filename],
+                             stdout=subprocess.PIPE, stdin=subprocess.PIPE)
+        out = p.communicate(input=stdin + b'\x00')[0]
+        lines = out.splitlines()
+        match = re.search(br'time:([0-9.]+)ms', lines[-1]) if lines else None
+        if not match:
+            return None, None, None
+        t = float(match.group(1))
+        best = t if best is None else min(best, t)
+        size = int(re.search(br'x86:(\d+)B', lines[0]).group(1))
+        # the program's output is between the two lines of stats
+        output = out[out.index(b'\n') + 1:out.rindex(b'time:')]
+    return best, size, output
+
+
+def first_byte(filename, flags, stdin):
+    # the best times to the first byte of output and to the end
+    best = None
+    with tempfile.TemporaryFile() as f:
+        f.write(stdin + b'\x00')
+        for _ in range(RUNS):
+            f.seek(0)
+            master, slave = pty.openpty()
+            start = time.time()
+            p = subprocess.Popen(['./beefit'] + flags + [filename],
+                                 stdin=f, stdout=slave)
+            os.close(slave)
+            first = None
+            while True:
+                try:
+                    data = os.read(master, 65536)
+                except OSError:  # the terminal closes with the program
+                    data = b''
+                if first is None:
+                    first = time.time() - start
+                if not data:
+                    break
+            p.wait()
+            os.close(master)
+            t = (first, time.time() - start)
+            best = t if best is None else (min(best[0], t[0]), min(best[1], t[1]))
+    return best
+
+
+def compile_rate(filename, flags):
+    # the best compiles per second, over enough compiles to take
+    # about a quarter of a second, or None
+    count, best = 100, None
+    for i in range(RUNS + 1):
+        p = subprocess.Popen(['./beefit', '-A', str(count)] + flags + [filename],
+                             stdout=subprocess.PIPE)
+        match = re.search(br'compiles/s:(\d+)', p.communicate()[0])
+        if not match:
+            return None
+        rate = int(match.group(1))
+        if i == 0:
+            count = max(count, rate // 4)
+        else:
+            best = rate if best is None else max(best, rate)
+    return best
+
+
+def programs(dirs):
+    for d in dirs:
+        for name in sorted(os.listdir(d)):
+            if name.endswith('.bf'):
+                yield os.path.join(d, name)
+
+
+def run_bench(flags):
+    print('%-20s' % '' + ''.join('%12s' % name for name, _ in backends))
+    for filename in programs(['bench']):
+        stdin = inputs[filename]() if filename in inputs else b''
+        times = [run(filename, flags + extra, stdin)[0]
+                 for _, extra in backends]
+        print('%-20s' % os.path.basename(filename) + ''.join(
+            '%10.1fms' % t if t is not None else '%12s' % 'failed'
+            for t in times))
+        sys.stdout.flush()
+
+
+def run_first_byte(flags):
+    columns = [('', []), ('-T', ['-T'])]
+    print('%-20s%24s%24s' % ('', 'first byte', 'total'))
+    print('%-20s' % '' + ''.join('%12s' % (name or 'default')
+                                 for name, _ in columns) * 2)
+    for filename in programs(['bench']):
+        stdin = inputs[filename]() if filename in inputs else b''
+        times = [first_byte(filename, flags + extra, stdin)
+                 for _, extra in columns]
+        print('%-20s' % os.path.basename(filename) +
+              ''.join('%10.1fms' % (t[0] * 1000) for t in times) +
+              ''.join('%10.1fms' % (t[1] * 1000) for t in times))
+        sys.stdout.flush()
+
+
+def run_compile(flags):
+    print('%-20s%12s' % ('', 'compiles/s'))
+    for filename in programs(['bench', 'test']):
+        rate = compile_rate(filename, flags)
+        print('%-20s' % filename + ('%12d' % rate if rate else '%12s' % 'failed'))
+        sys.stdout.flush()
+
+
+def passes():
+    # beefit lists them in its usage
+    p = subprocess.Popen(['./beefit', '-h'], stderr=subprocess.PIPE)
+    usage = p.communicate()[1].decode()
+    return re.search(r'passes: (.*)', usage).group(1).split()
+
+
+def run_ablation(flags):
+    # a pass that's needed for correct output shows up as wrong
+    columns = [('all', [])] + [(name, ['-X', name]) for name in passes()]
+    header = '%-20s' % '' + ''.join('%12s' % name for name, _ in columns)
+    times, sizes = [], []
+    for filename in programs(['bench', 'test']):
+        stdin = inputs[filename]() if filename in inputs else b''
+        results = [run(filename, flags + extra, stdin) for _, extra in columns]
+        expected = results[0][2]
+        row_times, row_sizes = [], []
+        for t, size, output in results:
+            if t is None:
+                row_times.append('%12s' % 'failed')
+                row_sizes.append('%12s' % 'failed')
+            elif output != expected:
+                row_times.append('%12s' % 'wrong')
+                row_sizes.append('%11dB' % size)
+            else:
+                row_times.append('%10.1fms' % t)
+                row_sizes.append('%11dB' % size)
+        times.append('%-20s' % filename + ''.join(row_times))
+        sizes.append('%-20s' % filename + ''.join(row_sizes))
+        print(times[-1], file=sys.stderr)
+    print('run time with each pass off')
+    print(header)
+    print('\n'.join(times))
+    print()
+    print('code size with each pass off')
+    print(header)
+    print('\n'.join(sizes))
+
+
+if __name__ == '__main__':
+    if sys.argv[1:2] == ['--ablate']:
+        run_ablation(sys.argv[2:])
+    elif sys.argv[1:2] == ['--first-byte']:
+        run_first_byte(sys.argv[2:])
+    elif sys.argv[1:2] == ['--compile']:
+        run_compile(sys.argv[2:])
+    else:
+        run_bench(sys.argv[1:])
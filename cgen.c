@@ -0,0 +1,221 @@
+// C backend for -C: the optimized code is written out as one C
+// function, built by the system compiler and loaded with dlopen.
+// slow to start, but the compiler's register allocation and
+// scheduling pay off on long runs.
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "beefit.h"
+
+static void *handle;
+
+// the runtime helpers are handed to the generated code as pointers,
+// since the executable doesn't export its symbols.
+static const char prelude[] =
+  "#include <stdint.h>\n"
+  "#include <stdio.h>\n"
+  "void (*bf_tape_overflow)(intptr_t);\n"
+  "uint8_t *(*bf_move_cells)(uint8_t *, uint8_t *, int);\n"
+  "uint8_t (*bf_echo_cells)(uint8_t, int);\n"
+  "uint32_t *bf_trace_counts;\n";
+
+static const char safe_cell[] =
+  "static inline uint8_t *cell(uint8_t *p, uint8_t *tape, long b) {\n"
+  "  uintptr_t i = p + b - tape;\n"
+  "  if (i >= %d)\n"
+  "    bf_tape_overflow(i);\n"
+  "  return p + b;\n"
+  "}\n"
+  "#define P(b) (*cell(p, tape, (b)))\n";
+
+static void write_code(FILE *f, ins_t *code) {
+  int indent = 2, counters = 0, loop_count = 0;
+  fputs(prelude, f);
+  if (safe)
+    fprintf(f, safe_cell, TAPE_SIZE);
+  else
+    fputs("#define P(b) (p[b])\n", f);
+  fputs("uint8_t *bf(uint8_t *p, uint8_t *tape) {\n", f);
+  fputs("  uint8_t t0 = 0, t1 = 0, t2 = 0, t3 = 0;\n", f);
+  fputs("  (void)tape; (void)t0; (void)t1; (void)t2; (void)t3;\n", f);
+  for (; code->op != OP_EOF; ++code) {
+    int t = code->t, a = code->a, b = code->b;
+    if (code->op == OP_LOOPNZ)
+      indent -= 2;
+    if (code->op != OP_NOP)
+      fprintf(f, "%*s", indent, "");
+    switch (code->op) {
+      case OP_SHIFT:
+        fprintf(f, "p += %d;\n", b);
+        break;
+      case OP_ADD:
+        fprintf(f, "P(%d) += %d;\n", b, a);
+        break;
+      case OP_SET:
+        fprintf(f, "P(%d) = %d;\n", b, a);
+        break;
+      case OP_SETT:
+        fprintf(f, "P(%d) = t%d;\n", b, t);
+        break;
+      case OP_ADDT:
+        fprintf(f, "P(%d) += t%d * %d;\n", b, t, a);
+        break;
+      case OP_LOAD:
+        fprintf(f, "t%d = P(%d) + %d;\n", t, b, a);
+        break;
+      case OP_TADD: {
+        // see the emitter: a sign in bit 7 and a 7 bit constant
+        int off = (int8_t)((a & 0x7f) | ((a & 0x40) << 1));
+        fprintf(f, "t%d = %st%d + %d + P(%d);\n", t, a & 0x80 ? "-" : "", t, off, b);
+        break;
+      }
+      case OP_MULT:
+        fprintf(f, "t%d *= P(%d);\n", t, b);
+        break;
+      case OP_CMP:
+        fprintf(f, "t%d = t%d < P(%d);\n", t, t, b);
+        break;
+      case OP_SKIPZ:
+        if (a == 2)
+          fprintf(f, "for (int n%d = %d; n%d; n%d--) {\n", counters, b, counters, counters);
+        else if (a)
+          fprintf(f, "do {\n");
+        else
+          fprintf(f, "if (P(%d)) do {\n", b);
+        counters += a == 2;
+        indent += 2;
+        if (trace)
+          fprintf(f, "%*sbf_trace_counts[%d]++;\n", indent, "", loop_count++);
+        break;
+      case OP_LOOPNZ:
+        if (a == 2) {
+          counters--;
+          fprintf(f, "}\n");
+        } else if (a) {
+          fprintf(f, "} while (0);\n");
+        } else {
+          fprintf(f, "} while (P(%d));\n", b);
+        }
+        break;
+      case OP_MOVE:
+        fprintf(f, "p = bf_move_cells(p, tape, %d);\n", a);
+        break;
+      case OP_DIVMOD: {
+        // see the emitter for when this is the loop after it
+        int d = b + a + 1;
+        fprintf(f, "if (!P(%d) && !P(%d) && !P(%d) && P(%d) != 1) {\n",
+                d + 1, d + 3, d + 4, d);
+        fprintf(f, "%*s  unsigned n = P(%d), d = P(%d) ? P(%d) : 256;\n",
+                indent, "", b, d, d);
+        fprintf(f, "%*s  P(%d) += n / d; P(%d) = n %% d; P(%d) -= n %% d;\n",
+                indent, "", d + 2, d + 1, d);
+        if (a)
+          fprintf(f, "%*s  P(%d) += n;\n", indent, "", b + 1);
+        fprintf(f, "%*s  P(%d) = 0;\n%*s}\n", indent, "", b, indent, "");
+        break;
+      }
+      case OP_CARRY:
+      case OP_BORROW: {
+        // see the emitter for when this is the loop after it
+        int n = b + a;
+        fprintf(f, "if (!P(%d) && !P(%d)) {\n", n + t, n + t + 1);
+        fprintf(f, "%*s  unsigned c = P(%d), d;\n", indent, "", b);
+        for (int i = 0; i < t; i++) {
+          if (code->op == OP_CARRY) {
+            fprintf(f, "%*s  d = P(%d) + c; P(%d) = d; c = d >> 8;\n",
+                    indent, "", n + i, n + i);
+          } else {
+            int o = i < t - 1;
+            fprintf(f, "%*s  d = (uint8_t)(P(%d) - %d); P(%d) = d - c + %d; c = d < c;\n",
+                    indent, "", n + i, o, n + i, o);
+          }
+        }
+        fprintf(f, "%*s  P(%d) = 0;\n%*s}\n", indent, "", b, indent, "");
+        break;
+      }
+      case OP_CAT:
+        fprintf(f, "P(%d) = bf_echo_cells(P(%d), %d);\n", b, b, a);
+        break;
+      case OP_PRINT:
+        fprintf(f, "putchar(P(%d));\n", b);
+        break;
+      case OP_READ:
+        fprintf(f, "P(%d) = getchar();\n", b);
+        break;
+      case OP_NOP:
+      case OP_EOF:
+        break;
+    }
+  }
+  fputs("  return p;\n}\n", f);
+}
+
+static void set_helper(char *name, void *value) {
+  void **slot = dlsym(handle, name);
+  if (slot)
+    *slot = value;
+}
+
+bf_ptr assemble_c(ins_t *code, int *size_out) {
+  char dir[] = "/tmp/beefitXXXXXX", src[64], so[64], cmd[256];
+  if (!mkdtemp(dir)) {
+    perror("unable to make a directory for the C backend");
+    exit(1);
+  }
+  snprintf(src, sizeof(src), "%s/bf.c", dir);
+  snprintf(so, sizeof(so), "%s/bf.so", dir);
+  FILE *f = fopen(src, "w");
+  if (!f) {
+    perror("unable to write the C backend's source");
+    exit(1);
+  }
+  write_code(f, code);
+  fclose(f);
+
+  if (debug) {
+    // keep the source next to the JIT's dump, even if it won't build
+    snprintf(cmd, sizeof(cmd), "cp %s /tmp/jitcode.c", src);
+    if (system(cmd))
+      fprintf(stderr, "warning: unable to copy %s to /tmp/jitcode.c\n", src);
+  }
+  char *cc = getenv("CC");
+  int len = snprintf(cmd, sizeof(cmd), "%s -O3 -shared -fPIC -o %s %s",
+                     cc ? cc : "cc", so, src);
+  if (len < 0 || len >= (int)sizeof(cmd)) {
+    fprintf(stderr, "error: $CC is too long\n");
+    exit(1);
+  }
+  if (system(cmd)) {
+    fprintf(stderr, "error: the C compiler failed on %s\n", src);
+    exit(1);
+  }
+
+  handle = dlopen(so, RTLD_NOW | RTLD_LOCAL);
+  if (!handle) {
+    fprintf(stderr, "error: %s\n", dlerror());
+    exit(1);
+  }
+  struct stat st;
+  *size_out = stat(so, &st) ? 0 : st.st_size;
+  unlink(src);
+  unlink(so);
+  rmdir(dir);
+
+  set_helper("bf_tape_overflow", tape_overflow);
+  set_helper("bf_move_cells", move_cells);
+  set_helper("bf_echo_cells", echo_cells);
+  set_helper("bf_trace_counts", trace_counts);
+  return (bf_ptr)dlsym(handle, "bf");
+}
+
+void release_c(bf_ptr fptr, int size) {
+  (void)fptr;
+  (void)size;
+  dlclose(handle);
+  handle = NULL;
+}
@@ -1,7 +1,9 @@
 // Driver file for DynASM-based JITs
 // based on public domain code from haberman's jitdemo
 
+#define _GNU_SOURCE  // for memrchr
 #include <stdio.h>
+#include <string.h>
 #include <sys/mman.h>
 #include <assert.h>
 
@@ -15,29 +17,120 @@ void err(char *msg) {
   exit(1);
 }
 
+void tape_overflow(intptr_t cell) {
+  fflush(stdout);
+  fprintf(stderr, "error: tape access out of bounds near cell %ld\n", (long)cell);
+  exit(1);
+}
+
+uint8_t *move_cells(uint8_t *ptr, uint8_t *tape, int off) {
+  // OP_MOVE: the run of nonzero cells from ptr up to the next zero,
+  // walking away from off, moves by off. the cells moved past the
+  // end of the run are added to, the rest are just overwritten.
+  // glibc's memchr and memrchr find the zero many bytes at a time.
+  uint8_t *end = tape + TAPE_SIZE, *start, *zero;
+  if (ptr < tape || ptr >= end)
+    tape_overflow(ptr - tape);
+  if (off < 0) {
+    zero = memchr(ptr, 0, end - ptr);
+    start = ptr;
+  } else {
+    zero = memrchr(tape, 0, ptr - tape + 1);
+    start = zero + 1;
+  }
+  if (!zero)
+    tape_overflow(off < 0 ? TAPE_SIZE : -1);
+  size_t n = off < 0 ? zero - ptr : ptr - zero;
+  if (!n)
+    return zero;
+  if (start + off < tape || start + off + n > end)
+    tape_overflow(start + off - tape);
+  size_t m = n < (size_t)abs(off) ? n : (size_t)abs(off);
+  // the first m cells walked go outside the run, the others land on
+  // cells that were already moved, so a plain memmove does them.
+  uint8_t *first = off < 0 ? start : start + n - m;
+  uint8_t *rest = off < 0 ? start + m : start;
+  for (size_t i = 0; i < m; i++)
+    first[off + i] += first[i];
+  memmove(rest + off, rest, n - m);
+  memset(off < 0 ? start + n - m : start, 0, m);
+  return zero;
+}
+
+uint8_t echo_cells(uint8_t cell, int add) {
+  // OP_CAT: the loop [ *0 -= add; print *0; *0 = read + add ]
+  // the bytes go straight from stdio's input buffer to its output
+  // buffer until the byte that stops it, however far away that is.
+  // at EOF the cell is what reading EOF leaves there, and the loop
+  // decides what's next.
+  uint8_t stop = -add;
+  int c;
+  if (!cell)
+    return 0;
+  putchar((uint8_t)(cell - add));
+  flockfile(stdin);
+  flockfile(stdout);
+  while ((c = getc_unlocked(stdin)) != EOF && (uint8_t)c != stop)
+    putc_unlocked(c, stdout);
+  funlockfile(stdout);
+  funlockfile(stdin);
+  return c == EOF ? (uint8_t)(EOF + add) : 0;
+}
+
+static int huge_code(size_t size) {
+  // only worth a huge page when the code would span many small ones
+  return hugepages && size >= HUGE_PAGE_SIZE / 2;
+}
+
 // generated from the .dasc file
 #include "emit_x64.gen.h"
 
 bf_ptr assemble(ins_t *code, int *size_out) {
+  return assemble_tiered(code, NULL, NULL, size_out);
+}
+
+bf_ptr assemble_tiered(ins_t *code, bf_ptr *entries, int *current, int *size_out) {
   dasm_State *state;
-  dasm_init(&state, 1);
+  void *labels[lbl__MAX];
+  dasm_init(&state, DASM_MAXSECTION);
+  dasm_setupglobal(&state, labels, lbl__MAX);
   dasm_setup(&state, actionlist);
 
-  emit(&state, code);
+  prof_block_t *prof = profiling ? prof_block() : NULL;
+  emit(&state, code, entries, current, prof);
 
   size_t size;
   int dasm_status = dasm_link(&state, &size);
   assert(dasm_status == DASM_S_OK);
 
-  char *mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
-                   MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-  assert(mem != MAP_FAILED);
+  // hardened systems may refuse executable pages,
+  // and then the caller falls back to interpreting.
+  // the code is written through another view of its memory, and
+  // jumps are all relative, so it runs where it's mapped to execute.
+  void *writable;
+  char *mem = alloc_code(size, huge_code(size), &writable);
+  if (!mem) {
+    dasm_free(&state);
+    if (prof)
+      prof_free(prof);
+    return NULL;
+  }
 
-  dasm_encode(&state, mem);
+  dasm_encode(&state, writable);
+  if (prof) {
+    for (int i = 0; i < prof->num_ops; i++)
+      prof->ops[i].addr = (uintptr_t)mem + dasm_getpclabel(&state, prof->ops[i].addr);
+  }
   dasm_free(&state);
 
-  int success = mprotect(mem, size, PROT_EXEC | PROT_READ);
-  assert(success == 0);
+  if (seal_code(mem, size, huge_code(size))) {
+    free_code(mem, size, huge_code(size));
+    if (prof)
+      prof_free(prof);
+    return NULL;
+  }
+  if (prof)
+    prof_place(prof, mem, size);
 
   if (debug) {
     // Write generated machine code to a temporary file.
@@ -53,3 +146,7 @@ bf_ptr assemble(ins_t *code, int *size_out) {
   *size_out = size;
   return (bf_ptr)mem;
 }
+
+void release(bf_ptr fptr, int size) {
+  free_code((void *)fptr, size, huge_code(size));
+}
@@ -0,0 +1,1039 @@
+/*
+** This file has been pre-processed with DynASM.
+** http://luajit.org/dynasm.html
+** DynASM version 1.3.0, DynASM x64 version 1.3.0
+** DO NOT EDIT! The original file is in "emit_x64.dasc".
+*/
+
+#if DASM_VERSION != 10300
+#error "Version mismatch between DynASM and included encoding engine"
+#endif
+
+# 1 "emit_x64.dasc"
+// based largely on Joshua Haberman's jitdemo
+// https://github.com/haberman/jitdemo/blob/master/jit3.dasc
+
+//|.arch x64
+//|.section code, cold
+#define DASM_SECTION_CODE	0
+#define DASM_SECTION_COLD	1
+#define DASM_MAXSECTION		2
+# 6 "emit_x64.dasc"
+//|.actionlist actionlist
+static const unsigned char actionlist[812] = {
+  78,141,156,253,37,233,73,129,252,251,239,15,135,244,10,255,237,255,252,243,
+  15,111,133,233,255,252,243,15,126,133,233,255,102,15,219,5,244,247,255,102,
+  15,252,252,5,244,248,255,102,15,110,200,240,0,252,242,15,112,201,0,102,15,
+  108,201,102,15,111,209,102,15,213,13,244,249,102,15,213,21,244,250,102,15,
+  219,13,244,251,102,15,252,235,202,102,15,252,252,193,255,252,243,15,127,133,
+  233,255,102,15,214,133,233,255,254,1,250,15,255,248,1,255,248,2,255,248,3,
+  255,248,4,255,248,5,252,255,0,252,255,0,252,255,0,252,255,0,252,255,0,252,
+  255,0,252,255,0,252,255,0,255,254,0,72,199,192,237,72,139,0,72,137,252,239,
+  76,137,230,72,252,247,222,72,133,192,15,132,244,247,252,255,208,254,1,248,
+  1,72,199,194,237,72,199,192,237,252,255,208,252,233,244,248,254,0,248,2,72,
+  137,197,255,249,255,85,83,65,84,65,85,65,86,65,87,72,131,252,236,8,72,137,
+  252,253,73,137,252,244,73,252,247,220,255,252,254,133,233,255,252,254,141,
+  233,255,128,133,233,235,255,128,173,233,235,255,72,252,255,197,255,72,252,
+  255,205,255,72,129,197,239,255,72,129,252,237,239,255,198,133,233,235,255,
+  138,133,253,240,2,233,255,252,254,192,240,0,255,252,254,200,240,0,255,128,
+  192,240,0,235,255,128,232,240,0,235,255,136,133,253,240,2,233,255,252,246,
+  216,240,0,255,2,133,253,240,2,233,255,252,246,165,233,255,68,15,182,157,233,
+  65,15,175,195,240,2,255,58,133,253,240,2,233,15,146,208,240,0,255,68,105,
+  216,240,0,239,68,0,157,233,255,40,133,253,240,2,233,255,0,133,253,240,2,233,
+  255,72,137,252,239,76,137,230,72,252,247,222,186,237,72,199,192,237,252,255,
+  208,72,137,197,255,15,182,189,233,190,237,72,199,192,237,252,255,208,136,
+  133,233,255,128,189,233,0,15,133,244,247,128,189,233,0,15,133,244,247,128,
+  189,233,0,15,133,244,247,68,15,182,157,233,65,131,252,251,1,15,132,244,247,
+  65,186,0,1,0,0,69,133,219,69,15,68,218,15,182,133,233,49,210,65,252,247,252,
+  243,0,133,233,136,149,233,40,149,233,255,138,133,233,0,133,233,255,198,133,
+  233,0,248,1,255,102,131,189,233,0,15,133,244,247,68,138,157,233,68,0,157,
+  233,255,128,149,233,0,255,102,131,189,233,0,15,133,244,247,255,128,173,233,
+  1,255,68,138,157,233,68,40,157,233,255,128,157,233,0,255,128,133,233,1,255,
+  252,233,244,247,254,1,72,15,182,189,233,72,199,192,237,252,255,208,252,233,
+  244,248,254,0,72,199,192,237,252,255,208,136,133,233,252,233,244,248,254,
+  0,128,189,233,0,65,15,149,210,65,252,246,218,255,68,40,149,233,255,68,0,149,
+  233,255,69,136,211,65,128,227,235,68,0,157,233,255,68,138,157,233,65,128,
+  252,243,235,69,32,211,68,48,157,233,255,198,133,233,0,255,72,199,192,237,
+  199,0,237,255,65,189,237,255,65,190,237,255,65,191,237,255,250,31,255,252,
+  233,245,255,128,189,233,0,15,132,245,255,252,255,4,37,237,255,65,252,255,
+  205,255,65,252,255,206,255,65,252,255,207,255,15,133,245,255,72,199,192,237,
+  72,139,0,72,133,192,15,133,244,247,254,1,248,1,72,137,252,239,76,137,230,
+  72,252,247,222,252,255,208,72,137,197,252,233,245,254,0,128,189,233,0,15,
+  133,245,255,72,137,232,72,131,196,8,65,95,65,94,65,93,65,92,91,93,195,255,
+  248,10,76,137,223,72,199,192,237,252,255,208,255
+};
+
+# 7 "emit_x64.dasc"
+//|.globals lbl_
+enum {
+  lbl_oob,
+  lbl__MAX
+};
+# 8 "emit_x64.dasc"
+//|
+//|.define PTR, rbp
+//|.define TMP, Rb(temps[code->t])  // al, cl, dl or bl
+//|.define BASE, r12  // negated tape start, for safe mode
+//|
+// dynamic registers are only encoded right up to 7, without a REX
+// prefix, so the temporaries are all in the first four and the
+// counters of counted loops, in r13-r15 by nesting depth, are picked
+// here. depth is tested more than once, so it mustn't have side effects.
+//|.macro setcounter, depth, n
+//||if (depth == 0) {
+//|  mov  r13d, n
+//||} else if (depth == 1) {
+//|  mov  r14d, n
+//||} else {
+//|  mov  r15d, n
+//||}
+//|.endmacro
+//|
+//|.macro deccounter, depth
+//||if (depth == 0) {
+//|  dec  r13d
+//||} else if (depth == 1) {
+//|  dec  r14d
+//||} else {
+//|  dec  r15d
+//||}
+//|.endmacro
+//|
+//|.macro callp, addr
+//|  mov  rax, (uintptr_t)addr
+//|  call rax
+//|.endmacro
+//|
+//|.macro addp, dest, change
+//||if (change == 1) {
+//|  inc dest
+//||} else if (change == -1) {
+//|  dec dest
+//||} else if (change > 0) {
+//|  add dest, change
+//||} else if (change < 0) {
+//|  sub dest, -change
+//||}
+//|.endmacro
+
+#define MAX_NESTING 256
+
+// registers of the temporaries, none of them survive calls
+static const int temps[NUM_TEMPS] = {0, 1, 2, 3};
+#define MAX_BRANCHLESS 4
+
+ins_t *loop_end(ins_t *code) {
+  // find the LOOPNZ matching the SKIPZ at code
+  int depth = 0;
+  do {
+    if (code->op == OP_SKIPZ)
+      depth++;
+    else if (code->op == OP_LOOPNZ)
+      depth--;
+    code++;
+  } while (depth);
+  return code - 1;
+}
+
+int innermost(ins_t *code) {
+  for (++code; code->op != OP_LOOPNZ; ++code) {
+    if (code->op == OP_SKIPZ)
+      return 0;
+  }
+  return 1;
+}
+
+int branchless(ins_t *code) {
+  // is the SKIPZ at code a small if, [ ... *0 = 0 }, whose
+  // body only adds or sets constants? returns the body size.
+  // -b keeps ifs as branches, as the masked ops would touch the
+  // body's cells even when it doesn't run.
+  if (code->a || trace || safe)
+    return 0;
+  int n = 0;
+  for (++code; code->op == OP_ADD || code->op == OP_SET; ++code) {
+    if (++n > MAX_BRANCHLESS)
+      return 0;
+  }
+  if (code->op != OP_LOOPNZ || !code->a || !n)
+    return 0;
+  ins_t *last = code - 1;
+  if (last->op != OP_SET || last->a != 0 || last->b != code->b)
+    return 0;
+  return n;
+}
+
+int loop_moves(ins_t *code) {
+  // does the loop starting at code contain any shifts or moves?
+  int depth = 0;
+  do {
+    if (code->op == OP_SKIPZ)
+      depth++;
+    else if (code->op == OP_LOOPNZ)
+      depth--;
+    else if (code->op == OP_SHIFT || code->op == OP_MOVE)
+      return 1;
+    code++;
+  } while (depth);
+  return 0;
+}
+
+int access_range(ins_t *code, int *lo, int *hi) {
+  // find the range of offsets accessed from code until PTR might change,
+  // i.e. until the next shift or boundary of a loop containing shifts.
+  // loops without shifts are checked once on the way in instead of
+  // every iteration. only their test counts here, as the body might
+  // not run at all, unless they're always entered.
+  int depth = 0;
+  int found = 0;
+  *lo = INT16_MAX;
+  *hi = INT16_MIN;
+  for (; code->op != OP_EOF; ++code) {
+    int reads = 1;
+    int stop = 0;
+    ins_t *skip = 0;
+    switch (code->op) {
+      case OP_SHIFT:
+      case OP_MOVE:
+        return found;
+      case OP_DIVMOD:
+        // and the cells after it up to the divmod loop's last
+        if (code->b + code->a + 5 > *hi) *hi = code->b + code->a + 5;
+        break;
+      case OP_CARRY:
+      case OP_BORROW:
+        // and the number, with the two cells after it
+        if (code->b + code->a < *lo) *lo = code->b + code->a;
+        if (code->b + code->a + code->t + 1 > *hi) *hi = code->b + code->a + code->t + 1;
+        break;
+      case OP_SKIPZ:
+        reads = !code->a;
+        if (loop_moves(code))
+          stop = 1;
+        else if (code->a)
+          depth++;
+        else
+          skip = loop_end(code);
+        break;
+      case OP_LOOPNZ:
+        reads = !code->a;
+        if (depth-- == 0)
+          stop = 1;
+        break;
+      case OP_NOP:
+        reads = 0;
+        break;
+      case OP_ADD:
+      case OP_SET:
+      case OP_SETT:
+      case OP_ADDT:
+      case OP_LOAD:
+      case OP_TADD:
+      case OP_MULT:
+      case OP_CMP:
+      case OP_CAT:
+      case OP_PRINT:
+      case OP_READ:
+      case OP_EOF:
+        break;
+    }
+    if (reads) {
+      found = 1;
+      if (code->b < *lo) *lo = code->b;
+      if (code->b > *hi) *hi = code->b;
+    }
+    if (stop)
+      return found;
+    if (skip)
+      code = skip;
+  }
+  return found;
+}
+
+void emit_check(dasm_State **Dst, ins_t *code) {
+  int lo, hi;
+  if (!safe || !access_range(code, &lo, &hi))
+    return;
+  // one unsigned compare checks both ends of the range
+  //|  lea  r11, [PTR+BASE+lo]
+  //|  cmp  r11, TAPE_SIZE - 1 - (hi - lo)
+  //|  ja   ->oob
+  dasm_put(Dst, 0, lo, TAPE_SIZE - 1 - (hi - lo));
+# 196 "emit_x64.dasc"
+}
+
+#define VECTOR 16
+
+int vector_run(ins_t *code, int *lo_out) {
+  // how many ops starting at code only add and set constants, or add
+  // one temporary, on cells within a vector's width of each other.
+  // returns 0 unless doing them all at once takes at most half the
+  // instructions: a wide store that is soon read back narrower or at
+  // another offset stalls store forwarding, so small wins are losses.
+  int lo = INT16_MAX, hi = INT16_MIN, n, t = -1;
+  int scalar = 0, sets = 0, adds = 0, products = 0;
+  for (n = 0; ; ++n) {
+    ins_t *ins = code + n;
+    if (ins->op == OP_NOP)
+      continue;
+    if (ins->op != OP_ADD && ins->op != OP_SET && ins->op != OP_ADDT)
+      break;
+    if (ins->op == OP_ADDT && t >= 0 && ins->t != t)
+      break;
+    int new_lo = ins->b < lo ? ins->b : lo;
+    int new_hi = ins->b > hi ? ins->b : hi;
+    if (new_hi - new_lo >= VECTOR)
+      break;
+    lo = new_lo;
+    hi = new_hi;
+    if (ins->op == OP_ADDT) {
+      t = ins->t;
+      products = 1;
+      scalar += ins->a > 2 || ins->a < -2 ? 2 : abs(ins->a);
+    } else {
+      sets |= ins->op == OP_SET;
+      adds |= ins->a != 0;
+      scalar++;
+    }
+  }
+  // load, mask, add the constants, multiply and add tmp, store
+  if (2 * (2 + sets + adds + 7 * products) > scalar)
+    return 0;
+  *lo_out = lo;
+  return n;
+}
+
+void emit_data(dasm_State **Dst, uint8_t *bytes, int words) {
+  // 16 bytes, or with words = 1 or 2 their even or odd bytes
+  // as the low or high bytes of 8 words
+  for (int i = 0; i < VECTOR; i += 4) {
+    uint32_t d;
+    if (words == 1) {
+      d = bytes[i] | bytes[i+2] << 16;
+    } else if (words == 2) {
+      d = bytes[i+1] << 8 | (uint32_t)bytes[i+3] << 24;
+    } else {
+      d = bytes[i] | bytes[i+1] << 8 | bytes[i+2] << 16 |
+          (uint32_t)bytes[i+3] << 24;
+    }
+    //|.dword d
+    dasm_put(Dst, 16, d);
+# 253 "emit_x64.dasc"
+  }
+}
+
+void emit_vector(dasm_State **Dst, ins_t *code, int n, int lo) {
+  // do n ops from vector_run together: every cell in the window
+  // becomes (cell & keep) + k + tmp * c
+  uint8_t keep[VECTOR], k[VECTOR], c[VECTOR];
+  int t = 0, sets = 0, adds = 0, products = 0, hi = lo;
+  memset(keep, 0xff, VECTOR);
+  memset(k, 0, VECTOR);
+  memset(c, 0, VECTOR);
+  for (ins_t *ins = code; ins < code + n; ++ins) {
+    int i = ins->b - lo;
+    if (ins->op == OP_NOP)
+      continue;
+    if (ins->b > hi)
+      hi = ins->b;
+    if (ins->op == OP_SET) {
+      keep[i] = 0;
+      k[i] = ins->a;
+      c[i] = 0;
+      sets = 1;
+    } else if (ins->op == OP_ADD) {
+      k[i] += ins->a;
+    } else {
+      c[i] += ins->a;
+      t = ins->t;
+      products = 1;
+    }
+  }
+  for (int i = 0; i < VECTOR; ++i)
+    adds |= k[i];
+  // past the last cell there's TAPE_SLACK to read and write back
+  int wide = hi - lo >= 8;
+
+  if (wide) {
+    //|  movdqu xmm0, [PTR+lo]
+    dasm_put(Dst, 18, lo);
+# 290 "emit_x64.dasc"
+  } else {
+    //|  movq   xmm0, qword [PTR+lo]
+    dasm_put(Dst, 25, lo);
+# 292 "emit_x64.dasc"
+  }
+  if (sets) {
+    //|  pand   xmm0, [>1]
+    dasm_put(Dst, 32);
+# 295 "emit_x64.dasc"
+  }
+  if (adds) {
+    //|  paddb  xmm0, [>2]
+    dasm_put(Dst, 39);
+# 298 "emit_x64.dasc"
+  }
+  if (products) {
+    // there's no byte multiply, so the even and odd bytes are
+    // multiplied as words, with tmp in every word
+    //|  movd   xmm1, Rd(temps[t])
+    //|  pshuflw xmm1, xmm1, 0
+    //|  punpcklqdq xmm1, xmm1
+    //|  movdqa xmm2, xmm1
+    //|  pmullw xmm1, [>3]
+    //|  pmullw xmm2, [>4]
+    //|  pand   xmm1, [>5]
+    //|  por    xmm1, xmm2
+    //|  paddb  xmm0, xmm1
+    dasm_put(Dst, 47, (temps[t]));
+# 311 "emit_x64.dasc"
+  }
+  if (wide) {
+    //|  movdqu [PTR+lo], xmm0
+    dasm_put(Dst, 96, lo);
+# 314 "emit_x64.dasc"
+  } else {
+    //|  movq   qword [PTR+lo], xmm0
+    dasm_put(Dst, 103, lo);
+# 316 "emit_x64.dasc"
+  }
+
+  // the constants go with the cold code, aligned for the SSE operands
+  //|.cold
+  dasm_put(Dst, 109);
+# 320 "emit_x64.dasc"
+  //|.align 16
+  dasm_put(Dst, 111);
+# 321 "emit_x64.dasc"
+  if (sets) {
+    //|1:
+    dasm_put(Dst, 114);
+# 323 "emit_x64.dasc"
+    emit_data(Dst, keep, 0);
+  }
+  if (adds) {
+    //|2:
+    dasm_put(Dst, 117);
+# 327 "emit_x64.dasc"
+    emit_data(Dst, k, 0);
+  }
+  if (products) {
+    //|3:
+    dasm_put(Dst, 120);
+# 331 "emit_x64.dasc"
+    emit_data(Dst, c, 1);
+    //|4:
+    dasm_put(Dst, 123);
+# 333 "emit_x64.dasc"
+    emit_data(Dst, c, 2);
+    //|5:
+    //|.dword 0x00ff00ff, 0x00ff00ff, 0x00ff00ff, 0x00ff00ff
+    dasm_put(Dst, 126);
+# 336 "emit_x64.dasc"
+  }
+  //|.code
+  dasm_put(Dst, 153);
+# 338 "emit_x64.dasc"
+}
+
+#define LAZY_MIN 256
+
+int lazy_region(ins_t *code, ins_t *first) {
+  // with -L, the number of ops from code that make up a loop big
+  // enough to be compiled on its first entry, with the loads hoisted
+  // in front of it. it has to set every temporary it uses itself,
+  // and can't be all that's being compiled.
+  if (!lazy)
+    return 0;
+  ins_t *start = code;
+  int loaded = 0;
+  for (; code->op == OP_LOAD; ++code)
+    loaded |= 1 << code->t;
+  if (code->op != OP_SKIPZ)
+    return 0;
+  ins_t *end = loop_end(code);
+  if (end - code < LAZY_MIN || (start == first && end[1].op == OP_EOF))
+    return 0;
+  for (ins_t *ins = code + 1; ins < end; ++ins) {
+    if (ins->op == OP_LOAD)
+      loaded |= 1 << ins->t;
+    else if ((ins->op == OP_SETT || ins->op == OP_ADDT || ins->op == OP_TADD ||
+              ins->op == OP_MULT || ins->op == OP_CMP) && !(loaded & 1 << ins->t))
+      return 0;
+  }
+  return end + 1 - start;
+}
+
+void emit_stub(dasm_State **Dst, ins_t *code, int n) {
+  // call the loop's code once it's compiled, or have it compiled.
+  // either way the new PTR comes back.
+  stub_t *stub = lazy_stub(code, n);
+  //|  mov  rax, (uintptr_t)&stub->fptr
+  //|  mov  rax, [rax]
+  //|  mov  rdi, PTR
+  //|  mov  rsi, BASE
+  //|  neg  rsi
+  //|  test rax, rax
+  //|  jz   >1
+  //|  call rax
+  //|.cold
+  dasm_put(Dst, 155, (uintptr_t)&stub->fptr);
+# 381 "emit_x64.dasc"
+  //|1:
+  //|  mov  rdx, (uintptr_t)stub
+  //|  callp &lazy_enter
+  //|  jmp  >2
+  //|.code
+  dasm_put(Dst, 185, (uintptr_t)stub, (uintptr_t)&lazy_enter);
+# 386 "emit_x64.dasc"
+  //|2:
+  //|  mov  PTR, rax
+  dasm_put(Dst, 204);
+# 388 "emit_x64.dasc"
+  emit_check(Dst, code + n);
+}
+
+void emit_mark(dasm_State **Dst, size_t *maxpc, prof_block_t *prof,
+               uint32_t src, int loop) {
+  // -p: a label for the code that follows, to find which op
+  // a sample is from
+  dasm_growpc(Dst, ++*maxpc);
+  //|=>(*maxpc-1):
+  dasm_put(Dst, 210, (*maxpc-1));
+# 397 "emit_x64.dasc"
+  prof_op(prof, *maxpc - 1, src, loop);
+}
+
+void emit(dasm_State **Dst, ins_t *code, bf_ptr *entries, int *current,
+          prof_block_t *prof) {
+  size_t maxpc = 0;
+  int pcstack[MAX_NESTING];
+  int movestack[MAX_NESTING];
+  int loopstack[MAX_NESTING];  // which loop, for entries
+  int profstack[MAX_NESTING];  // and in prof's loops, for -p
+  int *top = pcstack;
+  int *limit = pcstack + MAX_NESTING;
+  int loop_count = 0;
+  int loops = 0;
+  int counters = 0;
+  ins_t *first = code;
+  uint32_t src = 0;
+  int in_loop = -1;
+
+  // prologue. six pushes leave the stack 8 off from aligned
+  //|  push PTR
+  //|  push rbx
+  //|  push BASE
+  //|  push r13
+  //|  push r14
+  //|  push r15
+  //|  sub  rsp, 8
+  //|  mov  PTR, rdi
+  //|  mov  BASE, rsi
+  //|  neg  BASE
+  dasm_put(Dst, 212);
+# 427 "emit_x64.dasc"
+  emit_check(Dst, code);
+
+  for (; code->op != OP_EOF; ++code) {
+    if (prof && code->op != OP_NOP) {
+      if (code->src)
+        src = code->src - 1;
+      in_loop = top > pcstack ? profstack[top - pcstack - 1] : -1;
+      emit_mark(Dst, &maxpc, prof, src, in_loop);
+    }
+    int lo, n = lazy_region(code, first);
+    if (n) {
+      emit_stub(Dst, code, n);
+      code += n - 1;
+      continue;
+    }
+    n = vector_run(code, &lo);
+    if (n) {
+      emit_vector(Dst, code, n, lo);
+      code += n - 1;
+      continue;
+    }
+    switch (code->op) {
+      case OP_ADD:
+        //| addp byte [PTR+code->b], code->a
+        if (code->a == 1) {
+        dasm_put(Dst, 240, code->b);
+        } else if (code->a == -1) {
+        dasm_put(Dst, 245, code->b);
+        } else if (code->a > 0) {
+        dasm_put(Dst, 250, code->b, code->a);
+        } else if (code->a < 0) {
+        dasm_put(Dst, 255, code->b, -code->a);
+        }
+# 451 "emit_x64.dasc"
+        break;
+      case OP_SHIFT:
+        //| addp PTR, code->b
+        if (code->b == 1) {
+        dasm_put(Dst, 260);
+        } else if (code->b == -1) {
+        dasm_put(Dst, 265);
+        } else if (code->b > 0) {
+        dasm_put(Dst, 270, code->b);
+        } else if (code->b < 0) {
+        dasm_put(Dst, 275, -code->b);
+        }
+# 454 "emit_x64.dasc"
+        emit_check(Dst, code + 1);
+        break;
+      case OP_SET:
+        //|  mov byte [PTR+code->b], code->a
+        dasm_put(Dst, 281, code->b, code->a);
+# 458 "emit_x64.dasc"
+        break;
+      case OP_LOAD:
+        //|  mov  TMP, byte [PTR+code->b]
+        //|  addp TMP, code->a
+        dasm_put(Dst, 286, (temps[code->t]), code->b);
+        if (code->a == 1) {
+        dasm_put(Dst, 293, (temps[code->t]));
+        } else if (code->a == -1) {
+        dasm_put(Dst, 299, (temps[code->t]));
+        } else if (code->a > 0) {
+        dasm_put(Dst, 305, (temps[code->t]), code->a);
+        } else if (code->a < 0) {
+        dasm_put(Dst, 311, (temps[code->t]), -code->a);
+        }
+# 462 "emit_x64.dasc"
+        break;
+      case OP_SETT:
+        //|  mov byte [PTR+code->b], TMP
+        dasm_put(Dst, 317, (temps[code->t]), code->b);
+# 465 "emit_x64.dasc"
+        break;
+      case OP_TADD:
+        if (code->a & 0x80) {
+          //|  neg  TMP
+          dasm_put(Dst, 324, (temps[code->t]));
+# 469 "emit_x64.dasc"
+        }
+        if (code->a & 0x7f) {
+          int off = (int8_t)((code->a & 0x7f) | ((code->a & 0x40) << 1));
+          //| addp  TMP, off
+          if (off == 1) {
+          dasm_put(Dst, 293, (temps[code->t]));
+          } else if (off == -1) {
+          dasm_put(Dst, 299, (temps[code->t]));
+          } else if (off > 0) {
+          dasm_put(Dst, 305, (temps[code->t]), off);
+          } else if (off < 0) {
+          dasm_put(Dst, 311, (temps[code->t]), -off);
+          }
+# 473 "emit_x64.dasc"
+        }
+        //|  add  TMP, byte [PTR+code->b]
+        dasm_put(Dst, 330, (temps[code->t]), code->b);
+# 475 "emit_x64.dasc"
+        break;
+      case OP_MULT:
+        // only the low byte of the product matters
+        if (code->t == 0) {
+          //|  mul  byte [PTR+code->b]
+          dasm_put(Dst, 337, code->b);
+# 480 "emit_x64.dasc"
+        } else {
+          //|  movzx r11d, byte [PTR+code->b]
+          //|  imul Rd(temps[code->t]), r11d
+          dasm_put(Dst, 342, code->b, (temps[code->t]));
+# 483 "emit_x64.dasc"
+        }
+        break;
+      case OP_CMP:
+        //|  cmp  TMP, byte [PTR+code->b]
+        //|  setb TMP
+        dasm_put(Dst, 354, (temps[code->t]), code->b, (temps[code->t]));
+# 488 "emit_x64.dasc"
+        break;
+      case OP_ADDT:
+        {
+          int8_t diff = code->a;
+          if (diff > 2 || diff < -2) {
+            // the low byte of the product only depends on the low bytes
+            //|  imul r11d, Rd(temps[code->t]), diff
+            //|  add  byte [PTR+code->b], r11b
+            dasm_put(Dst, 366, (temps[code->t]), diff, code->b);
+# 496 "emit_x64.dasc"
+          } else if (diff < 0) {
+            for (int i = 0; i > diff; i--) {
+              //| sub  byte [PTR+code->b], TMP
+              dasm_put(Dst, 377, (temps[code->t]), code->b);
+# 499 "emit_x64.dasc"
+            }
+          } else if (diff > 0) {
+            for (int i = 0; i < diff; i++) {
+              //| add  byte [PTR+code->b], TMP
+              dasm_put(Dst, 384, (temps[code->t]), code->b);
+# 503 "emit_x64.dasc"
+            }
+          }
+        }
+        break;
+      case OP_MOVE:
+        // the helper checks its own bounds, and tells where ptr ends up
+        //|  mov  rdi, PTR
+        //|  mov  rsi, BASE
+        //|  neg  rsi
+        //|  mov  edx, code->a
+        //|  callp &move_cells
+        //|  mov  PTR, rax
+        dasm_put(Dst, 391, code->a, (uintptr_t)&move_cells);
+# 515 "emit_x64.dasc"
+        emit_check(Dst, code + 1);
+        break;
+      case OP_CAT:
+        //|  movzx edi, byte [PTR+code->b]
+        //|  mov  esi, code->a
+        //|  callp &echo_cells
+        //|  mov  byte [PTR+code->b], al
+        dasm_put(Dst, 415, code->b, code->a, (uintptr_t)&echo_cells, code->b);
+# 522 "emit_x64.dasc"
+        break;
+      case OP_DIVMOD:
+        {
+          // n d 0 0 0 0 => 0 d-n%d n%d n/d, when the loop after this
+          // would end in place: d isn't 1, and the zeros are there.
+          // a zero d counts to 256.
+          int n = code->b, d = code->b + code->a + 1;
+          //|  cmp  byte [PTR+d+1], 0
+          //|  jne  >1
+          //|  cmp  byte [PTR+d+3], 0
+          //|  jne  >1
+          //|  cmp  byte [PTR+d+4], 0
+          //|  jne  >1
+          //|  movzx r11d, byte [PTR+d]
+          //|  cmp  r11d, 1
+          //|  je   >1
+          //|  mov  r10d, 256
+          //|  test r11d, r11d
+          //|  cmovz r11d, r10d
+          //|  movzx eax, byte [PTR+n]
+          //|  xor  edx, edx
+          //|  div  r11d
+          //|  add  byte [PTR+d+2], al
+          //|  mov  byte [PTR+d+1], dl
+          //|  sub  byte [PTR+d], dl
+          dasm_put(Dst, 432, d+1, d+3, d+4, d, n, d+2, d+1, d);
+# 547 "emit_x64.dasc"
+          if (code->a) {
+            // the copy of n
+            //|  mov  al, byte [PTR+n]
+            //|  add  byte [PTR+n+1], al
+            dasm_put(Dst, 504, n, n+1);
+# 551 "emit_x64.dasc"
+          }
+          //|  mov  byte [PTR+n], 0
+          //|1:
+          dasm_put(Dst, 511, n);
+# 554 "emit_x64.dasc"
+        }
+        break;
+      case OP_CARRY:
+        {
+          // c n0..nk-1 0 0 => 0 n+c, when the loop after this finds
+          // its carries in the zeros: n is little-endian, and the sum
+          // is taken mod 256^k just as the loop does it.
+          int c = code->b, n = code->b + code->a, k = code->t;
+          //|  cmp  word [PTR+n+k], 0
+          //|  jne  >1
+          //|  mov  r11b, byte [PTR+c]
+          //|  add  byte [PTR+n], r11b
+          dasm_put(Dst, 518, n+k, c, n);
+# 566 "emit_x64.dasc"
+          for (int i = 1; i < k; i++) {
+            //|  adc  byte [PTR+n+i], 0
+            dasm_put(Dst, 536, n+i);
+# 568 "emit_x64.dasc"
+          }
+          //|  mov  byte [PTR+c], 0
+          //|1:
+          dasm_put(Dst, 511, c);
+# 571 "emit_x64.dasc"
+        }
+        break;
+      case OP_BORROW:
+        {
+          // the same counting down, where a cell borrows from the next
+          // as it gets to zero rather than as it wraps. that's a plain
+          // subtraction once all but the last cell are one less.
+          int c = code->b, n = code->b + code->a, k = code->t;
+          //|  cmp  word [PTR+n+k], 0
+          //|  jne  >1
+          dasm_put(Dst, 541, n+k);
+# 581 "emit_x64.dasc"
+          for (int i = 0; i < k - 1; i++) {
+            //|  sub  byte [PTR+n+i], 1
+            dasm_put(Dst, 551, n+i);
+# 583 "emit_x64.dasc"
+          }
+          //|  mov  r11b, byte [PTR+c]
+          //|  sub  byte [PTR+n], r11b
+          dasm_put(Dst, 556, c, n);
+# 586 "emit_x64.dasc"
+          for (int i = 1; i < k; i++) {
+            //|  sbb  byte [PTR+n+i], 0
+            dasm_put(Dst, 565, n+i);
+# 588 "emit_x64.dasc"
+          }
+          for (int i = 0; i < k - 1; i++) {
+            //|  add  byte [PTR+n+i], 1
+            dasm_put(Dst, 570, n+i);
+# 591 "emit_x64.dasc"
+          }
+          //|  mov  byte [PTR+c], 0
+          //|1:
+          dasm_put(Dst, 511, c);
+# 594 "emit_x64.dasc"
+        }
+        break;
+      // I/O is rare next to the loops around it,
+      // so it's kept out of line in the cold section.
+      case OP_PRINT:
+        //|  jmp >1
+        //|.cold
+        dasm_put(Dst, 575);
+# 601 "emit_x64.dasc"
+        //|1:
+        dasm_put(Dst, 114);
+# 602 "emit_x64.dasc"
+        if (prof) {
+          emit_mark(Dst, &maxpc, prof, src, in_loop);
+        }
+        //|  movzx  rdi, byte [PTR+code->b]
+        //|  callp   &putchar
+        //|  jmp >2
+        //|.code
+        dasm_put(Dst, 581, code->b, (uintptr_t)&putchar);
+# 609 "emit_x64.dasc"
+        //|2:
+        dasm_put(Dst, 117);
+# 610 "emit_x64.dasc"
+        break;
+      case OP_READ:
+        //|  jmp >1
+        //|.cold
+        dasm_put(Dst, 575);
+# 614 "emit_x64.dasc"
+        //|1:
+        dasm_put(Dst, 114);
+# 615 "emit_x64.dasc"
+        if (prof) {
+          emit_mark(Dst, &maxpc, prof, src, in_loop);
+        }
+        //|  callp   &getchar
+        //|  mov    byte [PTR+code->b], al
+        //|  jmp >2
+        //|.code
+        dasm_put(Dst, 599, (uintptr_t)&getchar, code->b);
+# 622 "emit_x64.dasc"
+        //|2:
+        dasm_put(Dst, 117);
+# 623 "emit_x64.dasc"
+        break;
+      case OP_SKIPZ:
+        loops++;
+        if (branchless(code)) {
+          // r10b = ptr[b] ? 0xff : 0, then each op is masked by it
+          int n = branchless(code);
+          //|  cmp  byte [PTR+code->b], 0
+          //|  setne r10b
+          //|  neg  r10b
+          dasm_put(Dst, 615, code->b);
+# 632 "emit_x64.dasc"
+          for (ins_t *ins = code + 1; ins < code + n; ++ins) {
+            if (ins->op == OP_ADD && ins->a == 1) {
+              //|  sub  byte [PTR+ins->b], r10b
+              dasm_put(Dst, 628, ins->b);
+# 635 "emit_x64.dasc"
+            } else if (ins->op == OP_ADD && ins->a == -1) {
+              //|  add  byte [PTR+ins->b], r10b
+              dasm_put(Dst, 633, ins->b);
+# 637 "emit_x64.dasc"
+            } else if (ins->op == OP_ADD) {
+              //|  mov  r11b, r10b
+              //|  and  r11b, ins->a
+              //|  add  byte [PTR+ins->b], r11b
+              dasm_put(Dst, 638, ins->a, ins->b);
+# 641 "emit_x64.dasc"
+            } else {
+              // *b ^= (*b ^ a) & mask
+              //|  mov  r11b, byte [PTR+ins->b]
+              //|  xor  r11b, ins->a
+              //|  and  r11b, r10b
+              //|  xor  byte [PTR+ins->b], r11b
+              dasm_put(Dst, 650, ins->b, ins->a, ins->b);
+# 647 "emit_x64.dasc"
+            }
+          }
+          // the condition cell ends up zero either way
+          //|  mov  byte [PTR+code->b], 0
+          dasm_put(Dst, 667, code->b);
+# 651 "emit_x64.dasc"
+          code += n + 1;
+          break;
+        }
+        if (top == limit) err("Nesting too deep.");
+        // Each loop gets three pclabels: at the end, the beginning
+        // of the body, and the test before the back-edge.
+        // We store pclabel offsets in a stack to link the loop
+        // begin and end together.
+        maxpc += 3;
+        movestack[top - pcstack] = loop_moves(code);
+        loopstack[top - pcstack] = loops - 1;
+        if (prof) {
+          profstack[top - pcstack] = prof_loop(prof, src, in_loop);
+        }
+        *top++ = maxpc;
+        dasm_growpc(Dst, maxpc);
+        if (entries) {
+          // tell -T's thread which loop to optimize next
+          //|  mov  rax, (uintptr_t)current
+          //|  mov  dword [rax], loops - 1
+          dasm_put(Dst, 672, (uintptr_t)current, loops - 1);
+# 671 "emit_x64.dasc"
+        }
+        if (code->a == 2) {
+          //|  setcounter counters, code->b
+          if (counters == 0) {
+          dasm_put(Dst, 680, code->b);
+          } else if (counters == 1) {
+          dasm_put(Dst, 684, code->b);
+          } else {
+          dasm_put(Dst, 688, code->b);
+          }
+# 674 "emit_x64.dasc"
+          counters++;
+          if (innermost(code)) {
+            //|.align 32
+            dasm_put(Dst, 692);
+# 677 "emit_x64.dasc"
+          }
+        } else if (!code->a) {
+          ins_t *end = loop_end(code);
+          // -b checks the body of a loop that doesn't move once it's
+          // known to run, which needs a way in apart from the back-edge
+          int check = safe && !movestack[top - pcstack - 1];
+          if (!check && !end->a && end->b == code->b) {
+            // enter through the back-edge test, so the guard isn't
+            // duplicated and the head can be aligned without
+            // executing any padding.
+            //|  jmp  =>(maxpc-1)
+            dasm_put(Dst, 695, (maxpc-1));
+# 688 "emit_x64.dasc"
+            if (innermost(code)) {
+              //|.align 32
+              dasm_put(Dst, 692);
+# 690 "emit_x64.dasc"
+            }
+          } else {
+            //|  cmp  byte [PTR+code->b], 0
+            //|  je   =>(maxpc-3)
+            dasm_put(Dst, 699, code->b, (maxpc-3));
+# 694 "emit_x64.dasc"
+            if (check)
+              emit_check(Dst, code + 1);
+          }
+        }
+        //|=>(maxpc-2):
+        dasm_put(Dst, 210, (maxpc-2));
+# 699 "emit_x64.dasc"
+        if (trace) {
+          //|   inc dword [(trace_counts+loop_count++)]
+          dasm_put(Dst, 707, (trace_counts+loop_count++));
+# 701 "emit_x64.dasc"
+        }
+        if (movestack[top - pcstack - 1]) {
+          emit_check(Dst, code + 1);
+        }
+        break;
+      case OP_LOOPNZ:
+        top--;
+        if (prof) {
+          prof->loops[profstack[top - pcstack]].end = src;
+        }
+        if (code->a == 2) {
+          //|=>(*top-1):
+          dasm_put(Dst, 210, (*top-1));
+# 713 "emit_x64.dasc"
+          counters--;
+          //|  deccounter counters
+          if (counters == 0) {
+          dasm_put(Dst, 713);
+          } else if (counters == 1) {
+          dasm_put(Dst, 718);
+          } else {
+          dasm_put(Dst, 723);
+          }
+# 715 "emit_x64.dasc"
+          //|  jnz  =>(*top-2)
+          dasm_put(Dst, 728, (*top-2));
+# 716 "emit_x64.dasc"
+        } else if (!code->a) {
+          //|=>(*top-1):
+          dasm_put(Dst, 210, (*top-1));
+# 718 "emit_x64.dasc"
+          if (entries) {
+            // -T: once the loop's optimized version is ready, it
+            // runs the rest of the loop and returns the new PTR
+            //|  mov  rax, (uintptr_t)(entries + loopstack[top - pcstack])
+            //|  mov  rax, [rax]
+            //|  test rax, rax
+            //|  jnz  >1
+            //|.cold
+            dasm_put(Dst, 732, (uintptr_t)(entries + loopstack[top - pcstack]));
+# 726 "emit_x64.dasc"
+            //|1:
+            //|  mov  rdi, PTR
+            //|  mov  rsi, BASE
+            //|  neg  rsi
+            //|  call rax
+            //|  mov  PTR, rax
+            //|  jmp  =>(*top-3)
+            //|.code
+            dasm_put(Dst, 748, (*top-3));
+# 734 "emit_x64.dasc"
+          }
+          //|  cmp  byte [PTR+code->b], 0
+          //|  jne  =>(*top-2)
+          dasm_put(Dst, 772, code->b, (*top-2));
+# 737 "emit_x64.dasc"
+        }
+        //|=>(*top-3):
+        dasm_put(Dst, 210, (*top-3));
+# 739 "emit_x64.dasc"
+        if (movestack[top - pcstack]) {
+          emit_check(Dst, code + 1);
+        }
+        break;
+      case OP_NOP:
+      case OP_EOF:
+        break;
+    }
+  }
+
+  // epilogue, returning where PTR ended up
+  //|  mov  rax, PTR
+  //|  add  rsp, 8
+  //|  pop r15
+  //|  pop r14
+  //|  pop r13
+  //|  pop BASE
+  //|  pop rbx
+  //|  pop PTR
+  //|  ret
+  dasm_put(Dst, 780);
+# 759 "emit_x64.dasc"
+
+  if (safe) {
+    //|->oob:
+    //|  mov  rdi, r11
+    //|  callp &tape_overflow
+    dasm_put(Dst, 799, (uintptr_t)&tape_overflow);
+# 764 "emit_x64.dasc"
+  }
+}
@@ -0,0 +1,305 @@
+// Threaded-code interpreter over the optimized code, for when
+// executable memory can't be had, or with -I. each op becomes a
+// handler address plus its operands, and pairs of ops that often
+// follow each other are merged into one handler to save dispatches.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "beefit.h"
+
+typedef struct thread {
+  const void *handler;
+  ins_t ins, next;      // next is the second op of a superinstruction
+  struct thread *jump;  // where a loop goes when it ends or repeats
+  int loop;             // which loop, for -t
+} thread_t;
+
+// handlers beyond the plain ops
+enum {
+  ENTER = OP_EOF + 1,  // { with -t
+  REPEAT,              // repeat N {
+  REPEAT_END,
+  SET_SKIPZ,
+  SHIFT_LOOPNZ,
+  LOAD_ADDT,
+  ADDT_ADDT,
+  ADD_ADD,
+  NUM_HANDLERS
+};
+
+#define MAX_COUNTERS 8
+
+static int fused(ins_t *a, ins_t *b) {
+  // the superinstruction for a followed by b, or 0
+  if (a->op == OP_SET && b->op == OP_SKIPZ && !b->a)
+    return SET_SKIPZ;
+  if (a->op == OP_SHIFT && b->op == OP_LOOPNZ && !b->a)
+    return SHIFT_LOOPNZ;
+  if (a->op == OP_LOAD && b->op == OP_ADDT && a->t == b->t)
+    return LOAD_ADDT;
+  if (a->op == OP_ADDT && b->op == OP_ADDT && a->t == b->t)
+    return ADDT_ADDT;
+  if (a->op == OP_ADD && b->op == OP_ADD)
+    return ADD_ADD;
+  return 0;
+}
+
+static int handler(ins_t *ins) {
+  // the handler for a single op, or -1 when it does nothing
+  if (ins->op == OP_SKIPZ && ins->a == 2)
+    return REPEAT;
+  if (ins->op == OP_SKIPZ)
+    return ins->a ? (trace ? ENTER : -1) : OP_SKIPZ;
+  if (ins->op == OP_LOOPNZ && ins->a == 2)
+    return REPEAT_END;
+  if (ins->op == OP_LOOPNZ)
+    return ins->a ? -1 : OP_LOOPNZ;
+  return ins->op == OP_NOP ? -1 : (int)ins->op;
+}
+
+static thread_t *thread(ins_t *code, const void **handlers) {
+  int len;
+  for (len = 0; code[len].op != OP_EOF; ++len) {}
+  thread_t *threads = calloc(len + 1, sizeof(thread_t));
+  int *match = malloc((len + 1) * sizeof(int));  // the other end of loops
+  int *number = malloc((len + 1) * sizeof(int)); // which loop, from 0
+  int *at = malloc((len + 1) * sizeof(int));     // the thread of each op
+  if (!threads || !match || !number || !at) {
+    perror("unable to allocate threaded code");
+    exit(1);
+  }
+  // at holds the open loops until the threads are made
+  int depth = 0, loop_count = 0;
+  for (int i = 0; i < len; ++i) {
+    if (code[i].op == OP_SKIPZ) {
+      number[i] = loop_count++;
+      at[depth++] = i;
+    } else if (code[i].op == OP_LOOPNZ) {
+      match[i] = at[--depth];
+      match[match[i]] = i;
+      number[i] = number[match[i]];
+    }
+  }
+
+  // at[i] is the first thread at or after code[i], so loops can jump
+  // past ends that don't need a thread. the ops loops jump to can't
+  // be the second half of a pair.
+  int n = 0;
+  for (int i = 0; i < len; ++i) {
+    at[i] = n;
+    int h = handler(code + i);
+    if (h < 0)
+      continue;
+    thread_t *t = threads + n++;
+    t->ins = code[i];
+    t->handler = handlers[h];
+    int f = i + 1 < len && code[i].op != OP_SKIPZ && code[i].op != OP_LOOPNZ ?
+        fused(code + i, code + i + 1) : 0;
+    if (f) {
+      t->next = code[++i];
+      t->handler = handlers[f];
+      at[i] = n - 1;
+    }
+    if (code[i].op == OP_SKIPZ || code[i].op == OP_LOOPNZ)
+      t->loop = number[i];
+  }
+  at[len] = n;
+  threads[n].handler = handlers[OP_EOF];
+
+  // a start jumps past its end, an end back to the op after its start
+  for (int i = 0; i < len; ++i) {
+    if (handler(code + i) < 0)
+      continue;
+    if (code[i].op == OP_SKIPZ || code[i].op == OP_LOOPNZ)
+      threads[at[i]].jump = threads + at[match[i] + 1];
+  }
+  free(match);
+  free(number);
+  free(at);
+  return threads;
+}
+
+static uint8_t *checked(uint8_t *cell, uint8_t *tape) {
+  if (cell < tape || cell >= tape + TAPE_SIZE)
+    tape_overflow(cell - tape);
+  return cell;
+}
+
+// the flags are copied to locals: stores to cells could alias the globals
+#define CELL(b) (*(check ? checked(p + (b), tape) : p + (b)))
+#define NEXT goto *(++ip)->handler
+#define JUMP { ip = ip->jump; goto *ip->handler; }
+#define COUNT if (count) trace_counts[ip->loop]++
+
+uint8_t *interpret(ins_t *code, uint8_t *p, uint8_t *tape) {
+  static const void *handlers[NUM_HANDLERS] = {
+    [OP_NOP] = &&nop,
+    [OP_SHIFT] = &&shift,
+    [OP_ADD] = &&add,
+    [OP_SET] = &&set,
+    [OP_SETT] = &&sett,
+    [OP_ADDT] = &&addt,
+    [OP_LOAD] = &&load,
+    [OP_TADD] = &&tadd,
+    [OP_MULT] = &&mult,
+    [OP_CMP] = &&cmp,
+    [OP_SKIPZ] = &&skipz,
+    [OP_LOOPNZ] = &&loopnz,
+    [OP_MOVE] = &&move,
+    [OP_DIVMOD] = &&divmod,
+    [OP_CARRY] = &&carry,
+    [OP_BORROW] = &&carry,
+    [OP_CAT] = &&cat,
+    [OP_PRINT] = &&print,
+    [OP_READ] = &&read,
+    [OP_EOF] = &&eof,
+    [ENTER] = &&enter,
+    [REPEAT] = &&repeat,
+    [REPEAT_END] = &&repeat_end,
+    [SET_SKIPZ] = &&set_skipz,
+    [SHIFT_LOOPNZ] = &&shift_loopnz,
+    [LOAD_ADDT] = &&load_addt,
+    [ADDT_ADDT] = &&addt_addt,
+    [ADD_ADD] = &&add_add,
+  };
+  thread_t *threads = thread(code, handlers), *ip = threads;
+  uint8_t t[NUM_TEMPS] = {0};
+  int counters[MAX_COUNTERS], *counter = counters;
+  const int check = safe, count = trace;
+  goto *ip->handler;
+
+nop:
+  NEXT;
+shift:
+  p += ip->ins.b;
+  NEXT;
+add:
+  CELL(ip->ins.b) += ip->ins.a;
+  NEXT;
+set:
+  CELL(ip->ins.b) = ip->ins.a;
+  NEXT;
+sett:
+  CELL(ip->ins.b) = t[ip->ins.t];
+  NEXT;
+addt:
+  CELL(ip->ins.b) += t[ip->ins.t] * ip->ins.a;
+  NEXT;
+load:
+  t[ip->ins.t] = CELL(ip->ins.b) + ip->ins.a;
+  NEXT;
+tadd: {
+  // see the emitter: a sign in bit 7 and a 7 bit constant
+  int a = ip->ins.a, off = (int8_t)((a & 0x7f) | ((a & 0x40) << 1));
+  uint8_t *tmp = &t[ip->ins.t];
+  *tmp = (a & 0x80 ? -*tmp : *tmp) + off + CELL(ip->ins.b);
+  NEXT;
+}
+mult:
+  t[ip->ins.t] *= CELL(ip->ins.b);
+  NEXT;
+cmp:
+  t[ip->ins.t] = t[ip->ins.t] < CELL(ip->ins.b);
+  NEXT;
+skipz:
+  if (!CELL(ip->ins.b))
+    JUMP;
+  COUNT;
+  NEXT;
+enter:
+  COUNT;
+  NEXT;
+loopnz:
+  if (CELL(ip->ins.b)) {
+    COUNT;
+    JUMP;
+  }
+  NEXT;
+repeat:
+  *counter++ = ip->ins.b;
+  COUNT;
+  NEXT;
+repeat_end:
+  if (--counter[-1]) {
+    COUNT;
+    JUMP;
+  }
+  counter--;
+  NEXT;
+move:
+  p = move_cells(p, tape, ip->ins.a);
+  NEXT;
+divmod: {
+  // see the emitter for when this is the loop after it
+  int n = ip->ins.b, d = n + ip->ins.a + 1;
+  if (!CELL(d + 1) && !CELL(d + 3) && !CELL(d + 4) && CELL(d) != 1) {
+    unsigned x = CELL(n), y = CELL(d) ? CELL(d) : 256;
+    CELL(d + 2) += x / y;
+    CELL(d + 1) = x % y;
+    CELL(d) -= x % y;
+    if (ip->ins.a)
+      CELL(n + 1) += x;
+    CELL(n) = 0;
+  }
+  NEXT;
+}
+carry: {
+  // see the emitter for when this is the loop after it
+  int n = ip->ins.b + ip->ins.a, k = ip->ins.t;
+  if (!CELL(n + k) && !CELL(n + k + 1)) {
+    unsigned c = CELL(ip->ins.b), d;
+    for (int i = 0; i < k; i++) {
+      if (ip->ins.op == OP_CARRY) {
+        d = CELL(n + i) + c;
+        CELL(n + i) = d;
+        c = d >> 8;
+      } else {
+        int o = i < k - 1;
+        d = (uint8_t)(CELL(n + i) - o);
+        CELL(n + i) = d - c + o;
+        c = d < c;
+      }
+    }
+    CELL(ip->ins.b) = 0;
+  }
+  NEXT;
+}
+cat:
+  CELL(ip->ins.b) = echo_cells(CELL(ip->ins.b), ip->ins.a);
+  NEXT;
+print:
+  putchar(CELL(ip->ins.b));
+  NEXT;
+read:
+  CELL(ip->ins.b) = getchar();
+  NEXT;
+set_skipz:
+  CELL(ip->ins.b) = ip->ins.a;
+  if (!CELL(ip->next.b))
+    JUMP;
+  COUNT;
+  NEXT;
+shift_loopnz:
+  p += ip->ins.b;
+  if (CELL(ip->next.b)) {
+    COUNT;
+    JUMP;
+  }
+  NEXT;
+load_addt:
+  t[ip->ins.t] = CELL(ip->ins.b) + ip->ins.a;
+  CELL(ip->next.b) += t[ip->ins.t] * ip->next.a;
+  NEXT;
+addt_addt:
+  CELL(ip->ins.b) += t[ip->ins.t] * ip->ins.a;
+  CELL(ip->next.b) += t[ip->ins.t] * ip->next.a;
+  NEXT;
+add_add:
+  CELL(ip->ins.b) += ip->ins.a;
+  CELL(ip->next.b) += ip->next.a;
+  NEXT;
+eof:
+  free(threads);
+  return p;
+}
@@ -0,0 +1,47 @@
+// Lazy compilation for -L: the emitter leaves a stub in place of each
+// big loop, and the loop is only assembled when it's first entered.
+// its own big loops get stubs in turn, so code that never runs is
+// never encoded. loops are cut out of the optimized code, where no
+// temporaries are live across their edges but the loads in front.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "beefit.h"
+
+static stub_t *stubs;
+
+stub_t *lazy_stub(ins_t *code, int n) {
+  stub_t *stub = malloc(sizeof(stub_t));
+  ins_t *copy = malloc((n + 2) * sizeof(ins_t));
+  if (!stub || !copy) {
+    perror("unable to allocate a lazy loop");
+    exit(1);
+  }
+  copy[0] = INS(OP_EOF, MID_START | MID_END, 0);
+  memcpy(copy + 1, code, n * sizeof(ins_t));
+  copy[n + 1] = INS(OP_EOF, 0, 0);
+  *stub = (stub_t){NULL, copy + 1, 0, stubs};
+  stubs = stub;
+  return stub;
+}
+
+uint8_t *lazy_enter(uint8_t *ptr, uint8_t *tape, stub_t *stub) {
+  stub->fptr = assemble(stub->code, &stub->size);
+  // out of executable memory, the loop can still be interpreted
+  if (!stub->fptr)
+    return interpret(stub->code, ptr, tape);
+  return stub->fptr(ptr, tape);
+}
+
+void lazy_release() {
+  while (stubs) {
+    stub_t *next = stubs->next;
+    if (stubs->fptr)
+      release(stubs->fptr, stubs->size);
+    free(stubs->code - 1);
+    free(stubs);
+    stubs = next;
+  }
+}
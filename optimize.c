@@ -1,4 +1,8 @@
 #include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include "beefit.h"
 
@@ -8,37 +12,169 @@ int trivial_dce(ins_t *code);
 int fold(ins_t *code);
 int condense(ins_t *code);
 int unloop(ins_t *code);
-int dce(ins_t *code);
-int peep(ins_t *code);
+int dce(ins_t *code, double deadline);
+int peep(ins_t *code, double deadline);
+int summarize(ins_t *code, double deadline);
 void peepfinal(ins_t *code);
+ins_t* closed_form(ins_t *code, int *changed);
+ins_t* unroll(ins_t *code, int *changed);
+int licm(ins_t *code);
+ins_t* peel(ins_t *code, int *changed);
+void hoist_loads(ins_t *code);
+void count_loops(ins_t *code);
+void block_moves(ins_t *code);
+ins_t* idioms(ins_t *code);
 
-int optimize(ins_t *code) {
+// the passes -X can turn off, as they're named there
+#define PASSES(X) \
+  X(fold) X(condense) X(trivial_dce) X(unloop) X(dce) X(peep) \
+  X(summarize) X(peepfinal) X(closed_form) X(unroll) X(licm) X(peel) \
+  X(hoist_loads) X(count_loops) X(block_moves) X(idioms)
+
+#define PASS_ENUM(name) PASS_##name,
+#define PASS_NAME(name) #name,
+enum { PASSES(PASS_ENUM) NUM_PASSES };
+static const char *pass_names[] = { PASSES(PASS_NAME) };
+
+STATIC_ASSERT(NUM_PASSES <= 32, passes_fit_mask);
+
+#define ON(name) !(disabled_passes & (1u << PASS_##name))
+
+int disable_pass(const char *name) {
+  for (int i = 0; i < NUM_PASSES; i++) {
+    if (!strcmp(name, pass_names[i])) {
+      disabled_passes |= 1u << i;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+void print_passes(FILE *out) {
+  for (int i = 0; i < NUM_PASSES; i++)
+    fprintf(out, "%s%s", pass_names[i], i + 1 < NUM_PASSES ? " " : "\n");
+}
+
+double now_ms() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+static int past(double deadline) {
+  return deadline && now_ms() > deadline;
+}
+
+// one go of a pass over long straight code can take far longer than
+// the budget, so the passes that repeat look at the clock as they go.
+// every so many ops is enough, reading it isn't free.
+#define CLOCK_EVERY 64
+
+static int late(int *ops, double deadline) {
+  return (*ops)++ % CLOCK_EVERY == 0 && past(deadline);
+}
+
+void optimize_fixpoint(ins_t *code, double deadline) {
   int changed;
 
-  // keep optimizing until there's nothing left
+  // keep optimizing until there's nothing left, or no time
   do {
     changed = 0;
-    changed |= fold(code);
-    changed |= condense(code);
-    changed |= trivial_dce(code);
-    changed |= unloop(code);
-    changed |= dce(code);
-    changed |= peep(code);
-  } while (changed);
-  peepfinal(code);
+    changed |= ON(fold) && fold(code);
+    changed |= ON(condense) && condense(code);
+    changed |= ON(trivial_dce) && trivial_dce(code);
+    changed |= ON(unloop) && unloop(code);
+    changed |= ON(dce) && dce(code, deadline);
+    changed |= ON(peep) && peep(code, deadline);
+    changed |= ON(summarize) && summarize(code, deadline);
+  } while (changed && !past(deadline));
+  if (ON(peepfinal))
+    peepfinal(code);
+}
+
+#define MAX_ROUNDS 4
+
+// how many ops a millisecond optimizes at each level, measured on
+// large programs, with room for slower machines
+#define OPS_PER_MS_1 2000
+#define OPS_PER_MS_2 500
+
+int choose_level(int size) {
+  // the most the budget fits, guessed from the size
+  if (!opt_budget || size <= opt_budget * OPS_PER_MS_2)
+    return 2;
+  if (size <= opt_budget * OPS_PER_MS_1)
+    return 1;
+  return 0;
+}
+
+int optimize(ins_t **codep) {
+  ins_t *code = *codep;
+  int len;
+  for (len = 0; code[len].op != OP_EOF; ++len) {}
+  int level = opt_level == OPT_AUTO ? choose_level(len) : opt_level;
+  if (level == 0)
+    return optimize_baseline(code);
+  // the guess can be wrong, so the passes that repeat stop early
+  // once the budget is spent. what they've done so far is kept.
+  double deadline = opt_budget ? now_ms() + opt_budget : 0;
+
+  optimize_fixpoint(code, deadline);
+
+  // these passes can grow the code, so they work on their own.
+  // peepfinal finds which loops are always entered, which lets
+  // them be peeled and have their invariants hoisted. another
+  // round of the passes then folds them into their surroundings.
+  for (int round = 0; level >= 2 && round < MAX_ROUNDS && !past(deadline); round++) {
+    int changed = 0;
+    if (ON(closed_form))
+      code = closed_form(code, &changed);
+    if (ON(unroll))
+      code = unroll(code, &changed);
+    changed |= ON(licm) && licm(code);
+    if (ON(peel))
+      code = peel(code, &changed);
+    if (!changed)
+      break;
+    optimize_fixpoint(code, deadline);
+  }
+  // tmp is normally dead across loop boundaries,
+  // so this has to happen after all the other passes.
+  if (ON(hoist_loads))
+    hoist_loads(code);
+  if (ON(count_loops))
+    count_loops(code);
+  if (ON(block_moves))
+    block_moves(code);
+  if (ON(idioms))
+    code = idioms(code);
+  *codep = code;
 
   int opt_size;
   for (opt_size = 0; code[opt_size].op != OP_EOF; ++opt_size) {}
   return opt_size;
 }
 
+int optimize_baseline(ins_t *code) {
+  // just enough for -T's first tier to start right away
+  if (ON(fold))
+    fold(code);
+  if (ON(condense))
+    condense(code);
+  int opt_size;
+  for (opt_size = 0; code[opt_size].op != OP_EOF; ++opt_size) {}
+  return opt_size;
+}
+
 int trivial_dce(ins_t *code) {
   // remove trivially dead code (comments)
   int changed = 0;
   for (; code->op != OP_EOF; ++code) {
-    if (code->op == OP_SKIPZ) {
+    if (code->op == OP_SKIPZ && !code->a) {
       // [ preceded by the beginning of the file or a ]
-      if (code[-1].op == OP_EOF || code[-1].op == OP_LOOPNZ) {
+      // ({ is known to be entered, even after a ])
+      if ((code[-1].op == OP_EOF && !(code[-1].a & MID_START)) ||
+          (code[-1].op == OP_LOOPNZ && code[-1].b == code->b)) {
         changed = 1;
         int depth = 0;
         do {
@@ -82,13 +218,37 @@ int fold(ins_t *code) {
   return changed;
 }
 
+ins_t* balanced(ins_t *code) {
+  // the end of the loop starting at code, if it and every loop
+  // inside it leave the pointer where it was, or 0 if not.
+  int shift = 0;
+  for (++code; code->op != OP_LOOPNZ; ++code) {
+    if (code->op == OP_SHIFT) {
+      shift += code->b;
+    } else if (code->op == OP_SKIPZ) {
+      code = balanced(code);
+      if (!code)
+        return 0;
+    }
+  }
+  return shift ? 0 : code;
+}
+
+#define MAX_NESTING 256
+
 int condense(ins_t *src) {
   // remove NOPs from the instruction stream,
   // and move SHIFTs to the end of instructions
   // e.g. +>+<< => ptr[0]++; ptr[1]++; ptr--;
+  // loops that don't move the pointer are carried along,
+  // e.g. >[-]> => [ptr[1] = 0]; ptr += 2
 
   ins_t *dst;
   int shift_offset = 0;
+  int depth = 0;
+  char keep[MAX_NESTING];  // is the loop at each depth carried along?
+  // code that doesn't end the program has to end where it moved to
+  int more = src[-1].a & MID_END;
   for (dst = src; src->op != OP_EOF; ++src) {
     assert(dst <= src);
     switch (src->op) {
@@ -96,6 +256,7 @@ int condense(ins_t *src) {
         shift_offset += src->b;
         break;
       case OP_TADD:
+      case OP_MULT:
       case OP_ADD:
       case OP_LOAD:
       case OP_ADDT:
@@ -107,32 +268,65 @@ int condense(ins_t *src) {
         *dst++ = *src;
         break;
       case OP_SKIPZ:
-      case OP_LOOPNZ:
-        if (shift_offset) {
-          *dst++ = (ins_t){OP_SHIFT, 0, shift_offset};
+      case OP_LOOPNZ: {
+        int kept;
+        if (src->op == OP_SKIPZ) {
+          kept = depth < MAX_NESTING && balanced(src);
+          if (depth < MAX_NESTING)
+            keep[depth] = kept;
+          depth++;
+        } else {
+          depth--;
+          kept = depth < MAX_NESTING && keep[depth];
+        }
+        if (kept) {
+          src->b += shift_offset;
+        } else if (shift_offset) {
+          *dst++ = INS(OP_SHIFT, 0, shift_offset);
           shift_offset = 0;
         }
         *dst++ = *src;
         break;
+      }
       case OP_NOP:
         // remove NOPs from instruction stream
         break;
+      case OP_MOVE:  // only made after the other passes
+      case OP_CMP:
+      case OP_DIVMOD:
+      case OP_CARRY:
+      case OP_BORROW:
+      case OP_CAT:
       case OP_EOF:
       default:
         assert("unreachable");
         break;
     }
   }
+  if (more && shift_offset)
+    *dst++ = INS(OP_SHIFT, 0, shift_offset);
   *dst = *src;
 
   return dst != src;
 }
 
+uint8_t inverse(uint8_t x) {
+  // multiplicative inverse of odd x mod 256, by newton's method.
+  // x is its own inverse mod 8, and every step doubles the bits.
+  uint8_t inv = x;
+  for (int i = 0; i < 3; ++i)
+    inv *= 2 - x * inv;
+  return inv;
+}
+
 int unloop(ins_t *code) {
   // "unloop" inner loops with only adds
   //  and no net shifts (no shifts after condense)
   // [-] => ptr[0] = 0
   // [->+<] => ptr[1] += ptr[0]; ptr[0] = 0
+  // with ptr[0] changing by an odd step s, the loop runs
+  // ptr[0] * -1/s times (mod 256), so every add is scaled by that:
+  // [--->+<] => ptr[1] += ptr[0] * 85; ptr[0] = 0
   //
   // note that this can cause out-of-bound
   // reads/writes, which are handled by padding
@@ -148,26 +342,34 @@ int unloop(ins_t *code) {
       loop_start = code;
     } else if (code->op == OP_LOOPNZ) {
       if (loop_good) {
-        // check that ptr[0] is decremented once
-        loop_good = 0;
-        for (ins_t *ins = loop_start; ins < code; ++ins) {
-          if (ins->op == OP_ADD && ins->a == -1 && ins->b == 0) {
-            loop_good = 1;
-            *ins = (ins_t){OP_SET, 0, 0};
-          }
+        // the loop has to change ptr[0] by an odd amount
+        int step = 0;
+        for (ins_t *ins = loop_start + 1; ins < code; ++ins) {
+          if (ins->op == OP_ADD && ins->b == loop_start->b)
+            step += ins->a;
         }
-        if (!loop_good) {
+        loop_good = 0;
+        if (!(step & 1)) {
           continue;
         }
+        int8_t scale = -inverse(step);
 
-        *loop_start = (ins_t){OP_LOAD, 0, 0};
-        *code = (ins_t){OP_NOP, 0, 0};
-
+        ins_t *counter = 0;
         for (ins_t *ins = loop_start + 1; ins < code; ++ins) {
-          if (ins->op == OP_ADD) {
-            *ins = (ins_t){OP_ADDT, ins->a, ins->b};
+          if (ins->op != OP_ADD) {
+            ;
+          } else if (ins->b != loop_start->b) {
+            *ins = INS(OP_ADDT, ins->a * scale, ins->b);
+          } else if (!counter) {
+            counter = ins;
+            *ins = INS(OP_SET, 0, ins->b);
+          } else {
+            ins->op = OP_NOP;
           }
         }
+
+        *loop_start = INS(OP_LOAD, 0, loop_start->b);
+        *code = INS(OP_NOP, 0, 0);
       }
     } else if (code->op != OP_ADD) {
       loop_good = 0;
@@ -182,6 +384,8 @@ ins_t* find_ref(ins_t *code, int dir) {
     ins_op_t op = code->op;
     if (op == OP_NOP) {
       ;
+    } else if (op == OP_MOVE) {
+      return 0;  // PTR ends up somewhere else
     } else if (code->b == off) {
       return code;
     } else if (op == OP_SKIPZ || op == OP_LOOPNZ || op == OP_SHIFT) {
@@ -191,6 +395,42 @@ ins_t* find_ref(ins_t *code, int dir) {
   return 0;
 }
 
+ins_t* find_ref_off(ins_t *code, int off, int dir) {
+  // like find_ref for the cell at off, but looks past loops
+  // that don't move the pointer and never touch the cell.
+  for (code += dir; code->op != OP_EOF; code += dir) {
+    ins_op_t op = code->op;
+    if (op == OP_NOP) {
+      ;
+    } else if (op == OP_MOVE) {
+      return 0;
+    } else if (code->b == off) {
+      return code;
+    } else if (op == (dir > 0 ? OP_SKIPZ : OP_LOOPNZ)) {
+      int depth = 0;
+      do {
+        if (code->op == OP_SKIPZ)
+          depth += dir;
+        else if (code->op == OP_LOOPNZ)
+          depth -= dir;
+        else if (code->op == OP_SHIFT || code->op == OP_MOVE)
+          return 0;
+        if (code->op != OP_NOP && code->b == off)
+          return 0;
+        code += dir;
+      } while (depth);
+      code -= dir;
+    } else if (op == OP_SKIPZ || op == OP_LOOPNZ || op == OP_SHIFT) {
+      return 0;
+    }
+  }
+  return 0;
+}
+
+ins_t* find_ref_across(ins_t *code, int dir) {
+  return find_ref_off(code, code->b, dir);
+}
+
 enum {
   READ_MEM =  1 << 0,
   WRITE_MEM = 1 << 1,
@@ -198,6 +438,7 @@ enum {
   WRITE_TMP = 1 << 3,
   ASSERT_MEM_ZERO = 1 << 4,
   DOES_IO = 1 << 5,
+  ALL_TMPS = 1 << 6,  // writes every temporary, as calls do
 };
 
 int op_effect[] = {
@@ -209,17 +450,26 @@ int op_effect[] = {
   [OP_ADDT] =   READ_MEM | WRITE_MEM | READ_TMP,
   [OP_LOAD] =   READ_MEM                        | WRITE_TMP,
   [OP_TADD] =   READ_MEM             | READ_TMP | WRITE_TMP,
+  [OP_MULT] =   READ_MEM             | READ_TMP | WRITE_TMP,
+  [OP_CMP] =    READ_MEM             | READ_TMP | WRITE_TMP,
   [OP_SKIPZ] =  READ_MEM,
   [OP_LOOPNZ] = READ_MEM | ASSERT_MEM_ZERO,
-  [OP_PRINT] =  READ_MEM                        | WRITE_TMP | DOES_IO,
-  [OP_READ] =              WRITE_MEM            | WRITE_TMP | DOES_IO,
+  [OP_MOVE] =   READ_MEM | WRITE_MEM            | WRITE_TMP | ALL_TMPS,
+  [OP_DIVMOD] = READ_MEM | WRITE_MEM            | WRITE_TMP | ALL_TMPS,
+  [OP_CARRY] =  READ_MEM | WRITE_MEM,
+  [OP_BORROW] = READ_MEM | WRITE_MEM,
+  [OP_CAT] =    READ_MEM | WRITE_MEM            | WRITE_TMP | ALL_TMPS | DOES_IO,
+  [OP_PRINT] =  READ_MEM                        | WRITE_TMP | ALL_TMPS | DOES_IO,
+  [OP_READ] =              WRITE_MEM            | WRITE_TMP | ALL_TMPS | DOES_IO,
   [OP_EOF] =   0,
 };
 
 ins_t* find_tref(ins_t *code, int dir, int type) {
+  // find the next use of code's temporary, calls clobber all of them
+  int t = code->t;
   for (code += dir; code->op != OP_EOF; code += dir) {
     ins_op_t op = code->op;
-    if (op_effect[op] & type) {
+    if (op_effect[op] & type && (code->t == t || op_effect[op] & ALL_TMPS)) {
       return code;
     } else if (op == OP_SKIPZ || op == OP_LOOPNZ) {
       return 0;
@@ -232,10 +482,11 @@ ins_t* find_tref(ins_t *code, int dir, int type) {
 #define CHANGEIF(ins, is_op, to_op) \
   if ((ins)->op == (is_op)) CHANGE((ins), (to_op))
 
-int dce(ins_t *code) {
+int dce(ins_t *code, double deadline) {
   int changed = 0;
+  int ops = 0;
 
-  for (; code->op != OP_EOF; ++code) {
+  for (; code->op != OP_EOF && !late(&ops, deadline); ++code) {
     ins_t *next = find_ref(code, 1);
     int eff_code = op_effect[code->op];
     int eff_next = next ? op_effect[next->op] : 0;
@@ -251,7 +502,7 @@ int dce(ins_t *code) {
         continue;
       }
     }
-    if (eff_code & WRITE_TMP && !(eff_code & DOES_IO)) {
+    if (eff_code & WRITE_TMP && !(eff_code & ALL_TMPS)) {
       ins_t *next_tref = find_tref(code, 1, WRITE_TMP | READ_TMP);
       if (!next_tref || !(op_effect[next_tref->op] & READ_TMP)) {
         // eliminate useless writes to tmp
@@ -273,10 +524,27 @@ int dce(ins_t *code) {
   return changed;
 }
 
-int peep(ins_t *code) {
+int untouched(ins_t *code) {
+  // is this the first use of the cell since the program started?
+  ins_t *ins;
+  for (ins = code - 1; ins->op != OP_EOF; --ins) {
+    if (ins->op == OP_SKIPZ || ins->op == OP_LOOPNZ || ins->op == OP_SHIFT)
+      return 0;
+    if (ins->op != OP_NOP && ins->b == code->b)
+      return 0;
+  }
+  return !(ins->a & MID_START);
+}
+
+int peep(ins_t *code, double deadline) {
   int changed = 0;
-  for (;code->op != OP_EOF; ++code) {
-    if (code->op == OP_LOAD) {
+  int ops = 0;
+  for (;code->op != OP_EOF && !late(&ops, deadline); ++code) {
+    if (code->op == OP_ADD && untouched(code)) {
+      //   the tape starts out zeroed
+      //   *A += B => *A = B
+      CHANGE(code, OP_SET);
+    } else if (code->op == OP_LOAD) {
       ins_t *prev = find_ref(code, -1);
       ins_t *next = find_ref(code, 1);
       if (prev && ((prev->op == OP_ADDT && (prev->a == 1 || prev->a == -1)) || prev->op == OP_SETT)
@@ -351,12 +619,14 @@ void peepfinal(ins_t *code) {
       //=> shift A; *0 += X
       int off = code->b;
       ins_t* prev = find_ref(code, -1);
-      if (prev) {
+      // another shift is only there without condense
+      if (prev && prev->op != OP_SKIPZ && prev->op != OP_LOOPNZ &&
+          prev->op != OP_SHIFT) {
         for (ins_t *dst = code; dst != prev; --dst) {
           *dst = *(dst - 1);
           dst->b -= off;
         }
-        *prev = (ins_t){OP_SHIFT, 0, off};
+        *prev = INS(OP_SHIFT, 0, off);
       }
     } if (code->op == OP_SKIPZ) {
       ins_t *prev = find_ref(code, -1);
@@ -371,7 +641,7 @@ void peepfinal(ins_t *code) {
         code->a = 1;
       }
     } else if (code->op == OP_LOOPNZ) {
-      ins_t *prev = find_ref(code, -1);
+      ins_t *prev = find_ref_across(code, -1);
       if (prev && prev->op == OP_LOOPNZ) {
         //   ] ]
         //=> ] }
@@ -391,3 +661,973 @@ void peepfinal(ins_t *code) {
     ++code;
   }
 }
+
+ins_t* match_loop(ins_t *code) {
+  // find the LOOPNZ matching the SKIPZ at code
+  int depth = 0;
+  do {
+    if (code->op == OP_SKIPZ)
+      depth++;
+    else if (code->op == OP_LOOPNZ)
+      depth--;
+    code++;
+  } while (depth);
+  return code - 1;
+}
+
+int loop_shifts(ins_t *start, ins_t *end) {
+  for (ins_t *ins = start; ins < end; ++ins) {
+    if (ins->op == OP_SHIFT)
+      return 1;
+  }
+  return 0;
+}
+
+int loop_nests(ins_t *start, ins_t *end) {
+  for (ins_t *ins = start; ins < end; ++ins) {
+    if (ins->op == OP_SKIPZ)
+      return 1;
+  }
+  return 0;
+}
+
+void hoist(ins_t *start, ins_t *ins) {
+  // move ins in front of the loop starting at start
+  ins_t moved = *ins;
+  memmove(start + 1, start, (ins - start) * sizeof(ins_t));
+  *start = moved;
+}
+
+// symbolic execution of straight-line code, tracking every cell
+// (and tmp) as an affine function of the cells' values on entry.
+#define MAX_VARS 16
+
+typedef struct {
+  uint8_t k;            // constant term
+  uint8_t c[MAX_VARS];  // coefficient of each cell's entry value
+} affine_t;
+
+typedef struct {
+  int n;
+  int16_t off[MAX_VARS];
+  affine_t cell[MAX_VARS];
+} affine_state_t;
+
+int affine_var(affine_state_t *s, int off) {
+  // index of the cell at off, which starts out as itself
+  for (int i = 0; i < s->n; ++i) {
+    if (s->off[i] == off)
+      return i;
+  }
+  if (s->n == MAX_VARS)
+    return -1;
+  memset(&s->cell[s->n], 0, sizeof(affine_t));
+  s->cell[s->n].c[s->n] = 1;
+  s->off[s->n] = off;
+  return s->n++;
+}
+
+void affine_add(affine_t *dst, affine_t *src, uint8_t mult) {
+  // dst += src * mult
+  dst->k += src->k * mult;
+  for (int i = 0; i < MAX_VARS; ++i)
+    dst->c[i] += src->c[i] * mult;
+}
+
+affine_t affine_subst(affine_t *e, affine_state_t *s) {
+  // e with every cell replaced by its value in s
+  affine_t out = {e->k, {0}};
+  for (int i = 0; i < s->n; ++i)
+    affine_add(&out, &s->cell[i], e->c[i]);
+  return out;
+}
+
+ins_t* affine_eval(ins_t *code, ins_t *end, affine_state_t *s) {
+  // run code symbolically, up to the first thing that isn't affine.
+  // returns where it stopped.
+  affine_t tmp = {0, {0}};
+  int tmp_set = 0;
+  for (; code < end; ++code) {
+    if (code->op == OP_NOP)
+      continue;
+    int v = affine_var(s, code->b);
+    if (v < 0 || code->t)
+      return code;
+    affine_t *cell = &s->cell[v];
+    switch (code->op) {
+      case OP_ADD:
+        cell->k += code->a;
+        break;
+      case OP_SET:
+        memset(cell, 0, sizeof(affine_t));
+        cell->k = code->a;
+        break;
+      case OP_SETT:
+      case OP_ADDT:
+        if (!tmp_set)
+          return code;
+        if (code->op == OP_SETT)
+          memset(cell, 0, sizeof(affine_t));
+        affine_add(cell, &tmp, code->op == OP_SETT ? 1 : code->a);
+        break;
+      case OP_LOAD:
+        tmp = *cell;
+        tmp.k += code->a;
+        tmp_set = 1;
+        break;
+      case OP_TADD: {
+        if (!tmp_set)
+          return code;
+        int off = (int8_t)((code->a & 0x7f) | ((code->a & 0x40) << 1));
+        affine_t sum = *cell;
+        affine_add(&sum, &tmp, code->a & 0x80 ? -1 : 1);
+        sum.k += off;
+        tmp = sum;
+        break;
+      }
+      case OP_NOP:
+      case OP_SHIFT:
+      case OP_MULT:
+      case OP_CMP:
+      case OP_SKIPZ:
+      case OP_LOOPNZ:
+      case OP_MOVE:
+      case OP_DIVMOD:
+      case OP_CARRY:
+      case OP_BORROW:
+      case OP_CAT:
+      case OP_PRINT:
+      case OP_READ:
+      case OP_EOF:
+        return code;
+    }
+  }
+  return code;
+}
+
+typedef struct {
+  ins_t *code;  // code[0] is the EOF sentinel in front
+  int len, size;
+} ins_buf_t;
+
+void append(ins_buf_t *buf, ins_t ins) {
+  if (buf->len == buf->size) {
+    buf->size *= 2;
+    buf->code = realloc(buf->code, buf->size * sizeof(ins_t));
+    assert(buf->code);
+  }
+  buf->code[buf->len++] = ins;
+}
+
+void append_product(ins_buf_t *buf, int dst, uint8_t coef, int a, int b) {
+  //   *dst += *a * *b * coef, or *a * coef without b
+  // tmp is only reloaded if it doesn't hold *a already
+  ins_t *prev = buf->code + buf->len - 1;
+  while (prev->op == OP_ADDT && prev->b != a)
+    prev--;
+  if (b != INT16_MIN || prev->op != OP_LOAD || prev->b != a || prev->a)
+    append(buf, INS(OP_LOAD, 0, a));
+  if (b != INT16_MIN)
+    append(buf, INS(OP_MULT, 0, b));
+  append(buf, INS(OP_ADDT, coef, dst));
+}
+
+int append_assign(ins_buf_t *out, affine_state_t *f,
+                  affine_t *lin, uint8_t (*quad)[MAX_VARS], int c) {
+  // write code that sets every cell in f at once to lin, plus the
+  // products of *c and the other cells in quad if there are any.
+  // each cell is updated in place, after every other cell that still
+  // needs its old value. fails when they depend on each other in a cycle.
+  int todo[MAX_VARS], product[MAX_VARS];
+  for (int i = 0; i < f->n; ++i) {
+    affine_t same = {0, {0}};
+    uint8_t none[MAX_VARS] = {0};
+    same.c[i] = 1;
+    product[i] = quad && memcmp(quad[i], none, sizeof(none));
+    todo[i] = memcmp(&lin[i], &same, sizeof(affine_t)) || product[i];
+    // the cell is scaled before anything else is added to it,
+    // which doesn't work if it's also multiplied by *c
+    if (todo[i] && lin[i].c[i] != 1 && quad && quad[i][i])
+      return 0;
+  }
+
+  while (1) {
+    int i, left = 0;
+    for (i = 0; i < f->n; ++i) {
+      if (!todo[i])
+        continue;
+      left = 1;
+      int k;
+      for (k = 0; k < f->n; ++k) {
+        if (k != i && todo[k] && (lin[k].c[i] || (quad && quad[k][i]) ||
+                                  (i == c && product[k])))
+          break;
+      }
+      if (k == f->n)
+        break;
+    }
+    if (!left)
+      return 1;
+    if (i == f->n)
+      return 0;
+    todo[i] = 0;
+
+    int16_t dst = f->off[i];
+    uint8_t scale = lin[i].c[i], k = lin[i].k;
+    int copy = -1;  // a cell the result can start out as
+    if (quad && quad[i][i])
+      append_product(out, dst, quad[i][i], f->off[c], dst);
+    if (scale == 0) {
+      for (int j = 0; j < f->n && copy < 0 && !(quad && quad[i][j]); ++j) {
+        if (lin[i].c[j] == 1)
+          copy = j;
+      }
+      if (copy >= 0) {
+        append(out, INS(OP_LOAD, k, f->off[copy]));
+        append(out, INS(OP_SETT, 0, dst));
+      } else {
+        append(out, INS(OP_SET, k, dst));
+      }
+      k = 0;
+    } else if (scale != 1) {
+      append_product(out, dst, scale - 1, dst, INT16_MIN);
+    }
+    for (int j = 0; j < f->n; ++j) {
+      if (j != i && j != copy && lin[i].c[j])
+        append_product(out, dst, lin[i].c[j], f->off[j], INT16_MIN);
+      if (j != i && quad && quad[i][j])
+        append_product(out, dst, quad[i][j], f->off[c], f->off[j]);
+    }
+    if (k)
+      append(out, INS(OP_ADD, k, dst));
+  }
+}
+
+int solve_loop(ins_t *start, ins_t *end, ins_buf_t *out) {
+  // replace a loop that doesn't move and runs straight-line affine
+  // code with its effect after n iterations, if every iteration
+  // after the first changes the cells by the same amount:
+  //   x_n = f(x) + (n - 1) * g(f(x)), where g(y) = f(y) - y
+  // each cell then only needs a few multiply-adds of the entry values.
+  //   [->[->+>+<<]>>[-<<+>>]<<<] => { *2 += *0 * *1 .. *0 = 0 }
+  affine_state_t f = {0};
+  int c = affine_var(&f, start->b);
+  if (affine_eval(start + 1, end, &f) != end)
+    return 0;
+
+  // the counter has to change by a constant step. with an odd step
+  // the loop runs n = *c * -1/step times (mod 256). with an even one,
+  // it only stops for some values of *c, so *c has to be known.
+  affine_t step = f.cell[c];
+  step.c[c] -= 1;
+  affine_t zero = {0, {0}};
+  if (!step.k || memcmp(zero.c, step.c, sizeof(step.c)))
+    return 0;
+  int n = 0;
+  ins_t *prev = find_ref_off(start, start->b, -1);
+  if (prev && prev->op == OP_SET && prev->a) {
+    uint8_t count = prev->a;
+    for (n = 1; n < 256 && (uint8_t)(count + n * step.k); ++n) {}
+    if (n == 256)
+      return 0;  // never stops
+  } else if (!(step.k & 1)) {
+    return 0;
+  }
+  uint8_t scale = -inverse(step.k);
+
+  affine_t lin[MAX_VARS];
+  uint8_t quad[MAX_VARS][MAX_VARS];  // coefficients of *c * *j
+  for (int i = 0; i < f.n; ++i) {
+    affine_t g = f.cell[i];
+    g.c[i] -= 1;
+    affine_t h = affine_subst(&g, &f);
+    affine_t h2 = affine_subst(&h, &f);
+    if (memcmp(&h, &h2, sizeof(affine_t)))
+      return 0;
+    lin[i] = f.cell[i];
+    memset(quad[i], 0, sizeof(quad[i]));
+    if (n) {
+      // f(x) + (n - 1) * h(x)
+      affine_add(&lin[i], &h, n - 1);
+    } else {
+      // f(x) - h(x) + *c * scale * h(x)
+      affine_add(&lin[i], &h, -1);
+      lin[i].c[c] += h.k * scale;
+      for (int j = 0; j < f.n; ++j)
+        quad[i][j] = h.c[j] * scale;
+    }
+  }
+  // the counter always ends up at zero
+  lin[c] = zero;
+
+  int len = out->len;
+  append(out, *start);
+  if (!append_assign(out, &f, lin, quad, c)) {
+    out->len = len;
+    return 0;
+  }
+  append(out, INS(OP_LOOPNZ, 1, end->b));
+  return 1;
+}
+
+int affine_op(ins_t *code) {
+  return code->op == OP_ADD || code->op == OP_SET || code->op == OP_SETT ||
+         code->op == OP_ADDT || code->op == OP_LOAD || code->op == OP_TADD ||
+         code->op == OP_NOP;
+}
+
+int summarize(ins_t *code, double deadline) {
+  // rewrite runs of affine code as the fewest ops with the same effect
+  // on the cells, when that's shorter than what's there.
+  //   tmp = *0; *1 += tmp; *2 += tmp; *0 = 0; tmp = *2; *0 += tmp; *2 = 0
+  //=> tmp = *0; *1 += tmp; tmp = *2; *0 += tmp; *2 = 0
+  int changed = 0;
+  ins_buf_t out = {malloc(16 * sizeof(ins_t)), 1, 16};
+  assert(out.code);
+  out.code[0] = INS(OP_EOF, 0, 0);
+  int ops = 0;
+  while (code->op != OP_EOF && !late(&ops, deadline)) {
+    if (!affine_op(code) || code->op == OP_NOP) {
+      ++code;
+      continue;
+    }
+    ins_t *end = code;
+    while (affine_op(end))
+      ++end;
+    affine_state_t f = {0};
+    end = affine_eval(code, end, &f);
+
+    int size = 0;
+    for (ins_t *ins = code; ins < end; ++ins)
+      size += ins->op != OP_NOP;
+    // tmp has to be dead afterwards, since it isn't kept
+    ins_t *next_tref = find_tref(end - 1, 1, READ_TMP | WRITE_TMP);
+    out.len = 1;
+    if (size > 1 && !(next_tref && op_effect[next_tref->op] & READ_TMP) &&
+        append_assign(&out, &f, f.cell, 0, -1) && out.len - 1 < size) {
+      memcpy(code, out.code + 1, (out.len - 1) * sizeof(ins_t));
+      for (ins_t *ins = code + out.len - 1; ins < end; ++ins)
+        ins->op = OP_NOP;
+      changed = 1;
+    }
+    code = end == code ? end + 1 : end;
+  }
+  free(out.code);
+  return changed;
+}
+
+ins_t* closed_form(ins_t *code, int *changed) {
+  // solve innermost loops that compute products of cells,
+  // see solve_loop. the solved loops are left as { } guards.
+  int len;
+  for (len = 0; code[len].op != OP_EOF; ++len) {}
+  ins_buf_t out = {malloc((len + 2) * sizeof(ins_t)), 1, len + 2};
+  assert(out.code);
+  out.code[0] = code[-1];
+
+  for (ins_t *ins = code; ins->op != OP_EOF; ++ins) {
+    if (ins->op == OP_SKIPZ) {
+      ins_t *end = match_loop(ins);
+      if (!end->a && solve_loop(ins, end, &out)) {
+        *changed = 1;
+        ins = end;
+        continue;
+      }
+    }
+    append(&out, *ins);
+  }
+  append(&out, INS(OP_EOF, 0, 0));
+  free(code - 1);
+  return out.code + 1;
+}
+
+int counted(ins_t *start, ins_t *end, ins_t **set, ins_t **dec) {
+  // the trip count of a loop that doesn't move, when its counter is
+  // set to a constant before it and only decremented once per iteration
+  int c = start->b;
+  ins_t *prev = find_ref_off(start, c, -1);
+  if (!prev || prev->op != OP_SET || !prev->a || end->b != c ||
+      loop_shifts(start, end))
+    return 0;
+  int depth = 0;
+  *set = prev;
+  *dec = 0;
+  for (ins_t *ins = start + 1; ins < end; ++ins) {
+    if (ins->op != OP_NOP && ins->b == c) {
+      if (ins->op != OP_ADD || ins->a != -1 || depth || *dec)
+        return 0;
+      *dec = ins;
+    }
+    if (ins->op == OP_SKIPZ)
+      depth++;
+    else if (ins->op == OP_LOOPNZ)
+      depth--;
+  }
+  return *dec ? (uint8_t)prev->a : 0;
+}
+
+#define MAX_UNROLL 64
+#define MAX_UNROLL_BODY 4
+
+void append_body(ins_buf_t *out, ins_t *start, ins_t *end, ins_t *dec, int n) {
+  // n copies of the loop body, without the counter
+  while (n--) {
+    for (ins_t *ins = start + 1; ins < end; ++ins) {
+      if (ins != dec && ins->op != OP_NOP)
+        append(out, *ins);
+    }
+  }
+}
+
+ins_t* unroll(ins_t *code, int *changed) {
+  // unroll innermost loops that run a known number of times,
+  // completely when that's short:
+  //   *0 = 3 [ B *0 -= 1 ] => *0 = 0 B B B
+  // and otherwise 4 or 8 times, with the remainder in front:
+  //   *0 = 10 [ B *0 -= 1 ] => *0 = 2 B B [ B B B B *0 -= 1 ]
+  int len;
+  for (len = 0; code[len].op != OP_EOF; ++len) {}
+  int *count = calloc(len, sizeof(int));
+  int *factor = calloc(len, sizeof(int));
+  assert(count && factor);
+
+  // first fix up the counters, which come before the loops
+  for (int i = 0; i < len; ++i) {
+    if (code[i].op != OP_SKIPZ)
+      continue;
+    ins_t *end = match_loop(code + i), *set, *dec;
+    if (loop_nests(code + i + 1, end))
+      continue;
+    int n = counted(code + i, end, &set, &dec), size = 0;
+    for (ins_t *ins = code + i + 1; ins < end; ++ins)
+      size += ins->op != OP_NOP && ins != dec;
+    if (!n) {
+      continue;
+    } else if (n * size <= MAX_UNROLL) {
+      set->a = 0;
+    } else if (size <= MAX_UNROLL_BODY) {
+      factor[i] = size <= 2 ? 8 : 4;
+      set->a = n / factor[i];
+    } else {
+      continue;
+    }
+    count[i] = n;
+    *changed = 1;
+  }
+
+  ins_buf_t out = {malloc((len + 2) * sizeof(ins_t)), 1, len + 2};
+  assert(out.code);
+  out.code[0] = code[-1];
+  for (int i = 0; i < len; ++i) {
+    if (!count[i]) {
+      append(&out, code[i]);
+      continue;
+    }
+    ins_t *end = match_loop(code + i), *dec = 0;
+    for (ins_t *ins = code + i + 1; ins < end; ++ins) {
+      if (ins->op == OP_ADD && ins->b == code[i].b)
+        dec = ins;
+    }
+    if (!factor[i]) {
+      append_body(&out, code + i, end, dec, count[i]);
+    } else {
+      append_body(&out, code + i, end, dec, count[i] % factor[i]);
+      append(&out, code[i]);
+      append_body(&out, code + i, end, dec, factor[i]);
+      append(&out, *dec);
+      append(&out, *end);
+    }
+    i = end - code;
+  }
+  append(&out, INS(OP_EOF, 0, 0));
+  free(count);
+  free(factor);
+  free(code - 1);
+  return out.code + 1;
+}
+
+int licm(ins_t *code) {
+  // within loops that don't move the pointer, remove sets of
+  // cells that always hold that value already, and hoist sets that
+  // happen before any other use of the cell out of { loops.
+  //   *1 = 5 [ .. *1 = 5 .. ] => *1 = 5 [ .. .. ]
+  //   { *1 = 5 .. ] => *1 = 5 { .. ]
+  int changed = 0;
+  for (; code->op != OP_EOF; ++code) {
+    if (code->op != OP_SKIPZ)
+      continue;
+    ins_t *end = match_loop(code);
+    if (loop_shifts(code, end))
+      continue;
+    int depth = 0;
+    for (ins_t *ins = code + 1; ins < end; ++ins) {
+      if (ins->op == OP_SKIPZ)
+        depth++;
+      else if (ins->op == OP_LOOPNZ)
+        depth--;
+      if (ins->op != OP_SET || depth)
+        continue;
+
+      // is this the only value the loop writes to the cell,
+      // and is it the first thing in the body to touch it?
+      int off = ins->b, val = ins->a;
+      int invariant = 1, first = 1;
+      for (ins_t *other = code + 1; other < end; ++other) {
+        if (other->op == OP_NOP || other->b != off || other == ins)
+          continue;
+        if (other < ins)
+          first = 0;
+        if (op_effect[other->op] & WRITE_MEM &&
+            (other->op != OP_SET || other->a != val))
+          invariant = 0;
+      }
+      if (!invariant)
+        continue;
+
+      ins_t *prev = find_ref_off(code, off, -1);
+      if (prev && prev->op == OP_SET && prev->a == val) {
+        // already holds the value on entry
+      } else if (code->a && first) {
+        hoist(code, ins);
+        changed = 1;
+        break;
+      } else {
+        continue;
+      }
+      for (ins_t *other = code + 1; other <= end; ++other) {
+        if (other->op == OP_SET && other->b == off) {
+          CHANGE(other, OP_NOP);
+        }
+      }
+    }
+  }
+  return changed;
+}
+
+#define MAX_PEEL 8
+
+ins_t* peel(ins_t *code, int *changed) {
+  // peel the first iteration of short innermost { loops,
+  // so it can be optimized along with the code before it.
+  // loops that move gain nothing from it, their cells change
+  // with every iteration.
+  //   { B ] => B [ B ]
+  //   { B } => B
+  int len;
+  for (len = 0; code[len].op != OP_EOF; ++len) {}
+
+  for (int i = 0; i < len; ++i) {
+    if (code[i].op != OP_SKIPZ || !code[i].a)
+      continue;
+    int end, size = 0;
+    for (end = i + 1; code[end].op != OP_LOOPNZ; ++end) {
+      if (code[end].op == OP_SKIPZ)
+        break;
+      if (code[end].op != OP_NOP)
+        size++;
+    }
+    if (code[end].op != OP_LOOPNZ || size > MAX_PEEL ||
+        (!code[end].a && loop_shifts(code + i, code + end)))
+      continue;
+
+    *changed = 1;
+    if (code[end].a) {
+      code[i].op = OP_NOP;
+      code[end].op = OP_NOP;
+      continue;
+    }
+
+    // make room for a copy of the body in front of the loop
+    int body = end - i - 1;
+    code = realloc(code - 1, (len + body + 2) * sizeof(ins_t));
+    assert(code);
+    code++;
+    memmove(code + i + body, code + i, (len - i + 1) * sizeof(ins_t));
+    memcpy(code + i, code + i + body + 1, body * sizeof(ins_t));
+    len += body;
+    i += body;
+    code[i].a = 0;
+  }
+  return code;
+}
+
+int hoist_temps(ins_t *start, ins_t *end, int apply) {
+  // give each value loaded in the loop its own temporary, following
+  // every temporary from where it's loaded to its uses.
+  // fails unless all of them are loads of cells the loop never writes.
+  ins_t *loads[NUM_TEMPS];
+  int n = 0, map[1 << 3];
+  for (int t = 0; t < (1 << 3); ++t)
+    map[t] = -1;
+  for (ins_t *ins = start + 1; ins < end; ++ins) {
+    int eff = op_effect[ins->op];
+    if (eff & READ_TMP) {
+      if (map[ins->t] < 0)
+        return 0;
+      if (apply)
+        ins->t = map[ins->t];
+    }
+    if (!(eff & WRITE_TMP))
+      continue;
+    if (ins->op != OP_LOAD)
+      return 0;
+    for (ins_t *other = start + 1; other < end; ++other) {
+      if (other->op != OP_NOP && other->b == ins->b &&
+          op_effect[other->op] & WRITE_MEM)
+        return 0;
+    }
+    int t;
+    for (t = 0; t < n; ++t) {
+      if (loads[t]->b == ins->b && loads[t]->a == ins->a)
+        break;
+    }
+    if (t == n) {
+      if (n == NUM_TEMPS)
+        return 0;
+      loads[n++] = ins;
+    }
+    map[ins->t] = t;
+    if (apply)
+      ins->t = t;
+  }
+  return n;
+}
+
+void hoist_loads(ins_t *code) {
+  // hoist loads of cells a loop never writes, when nothing else
+  // in the loop writes temporaries, out of loops that don't move.
+  // each value gets its own temporary so they can all stay loaded.
+  //   [ tmp = *1 *2 += tmp tmp = *3 *4 += tmp ]
+  //=> tmp = *1 tmp1 = *3 [ *2 += tmp *4 += tmp1 ]
+  // loops are visited innermost first, so loads can keep moving out.
+  ins_t *begin = code;
+  while (code->op != OP_EOF)
+    code++;
+  for (; code >= begin; --code) {
+    if (code->op != OP_SKIPZ)
+      continue;
+    ins_t *end = match_loop(code);
+    if (loop_shifts(code, end) || !hoist_temps(code, end, 0))
+      continue;
+    int n = hoist_temps(code, end, 1);
+    // hoist the first load into each temporary, the rest are redundant
+    ins_t *start = code;
+    for (int t = 0; t < n; ++t) {
+      for (ins_t *ins = start + 1; ins < end; ++ins) {
+        if (ins->op == OP_LOAD && ins->t == t) {
+          hoist(start++, ins);
+          break;
+        }
+      }
+    }
+    for (ins_t *ins = start + 1; ins < end; ++ins) {
+      if (ins->op == OP_LOAD)
+        ins->op = OP_NOP;
+    }
+  }
+}
+
+#define MAX_COUNTERS 3
+
+void count_loops(ins_t *code) {
+  // keep the counters of loops with a known trip count in registers,
+  // see counted. there are only a few registers to spare for them.
+  //   *0 = N [ B *0 -= 1 ] => *0 = 0 repeat N { B }
+  ins_t *ends[MAX_COUNTERS];
+  int open = 0;
+  for (; code->op != OP_EOF; ++code) {
+    if (open && code == ends[open - 1]) {
+      open--;
+      continue;
+    }
+    if (code->op != OP_SKIPZ || open == MAX_COUNTERS)
+      continue;
+    ins_t *end = match_loop(code), *set, *dec;
+    int n = counted(code, end, &set, &dec);
+    if (!n)
+      continue;
+    set->a = 0;
+    dec->op = OP_NOP;
+    *code = INS(OP_SKIPZ, 2, n);
+    end->a = 2;
+    ends[open++] = end;
+  }
+}
+
+void block_moves(ins_t *code) {
+  // loops that walk a run of cells moving each one by d against
+  // the walk shift the whole run, which is a memmove once the zero
+  // at its end is found.
+  //   [ tmp = *0 *0 = 0 *d += tmp shift s ] => move run by d
+  // with s = 1 and d < 0, or s = -1 and d > 0
+  for (; code->op != OP_EOF; ++code) {
+    if (code->op != OP_SKIPZ || code->a == 2 || code->b)
+      continue;
+    ins_t *end = match_loop(code), *body[5];  // one more to see it's too long
+    int n = 0;
+    for (ins_t *ins = code + 1; ins < end && n < 5; ++ins) {
+      if (ins->op != OP_NOP)
+        body[n++] = ins;
+    }
+    if (n != 4 || end->a || end->b)
+      continue;
+    ins_t *load = body[0], *set = body[1], *add = body[2], *shift = body[3];
+    if (set->op == OP_ADDT) {
+      set = body[2];
+      add = body[1];
+    }
+    int d = add->b, s = shift->b;
+    if (load->op != OP_LOAD || load->a || load->b ||
+        set->op != OP_SET || set->a || set->b ||
+        add->op != OP_ADDT || add->a != 1 || add->t != load->t ||
+        shift->op != OP_SHIFT || (s != 1 && s != -1) ||
+        d * s >= 0 || d < INT8_MIN || d > INT8_MAX)
+      continue;
+    *code = INS(OP_MOVE, d, 0);
+    for (ins_t *ins = code + 1; ins <= end; ++ins)
+      ins->op = OP_NOP;
+    code = end;
+  }
+}
+
+ins_t* next_op(ins_t *code) {
+  while ((++code)->op == OP_NOP) {}
+  return code;
+}
+
+int match_ops(ins_t *code, ins_t *want, int n) {
+  // do the n ops after code, NOPs aside, have the wanted ops and
+  // operands, with each temporary read after the load that sets it?
+  int t = -1;
+  for (int i = 0; i < n; i++) {
+    code = next_op(code);
+    // a set from a temporary can keep the a of the add it was
+    if (code->op != want[i].op || code->b != want[i].b ||
+        (code->a != want[i].a && code->op != OP_SETT))
+      return 0;
+    if (code->op == OP_LOAD)
+      t = code->t;
+    else if (op_effect[code->op] & READ_TMP && code->t != t)
+      return 0;
+  }
+  return 1;
+}
+
+int known_zero(ins_t *code, int off) {
+  // is the cell at off zero on the way into code?
+  ins_t *prev = find_ref_off(code, off, -1);
+  return prev && ((prev->op == OP_SET && !prev->a) ||
+                  (prev->op == OP_LOOPNZ && prev->a != 2));
+}
+
+ins_t divmod_loop(ins_t *code) {
+  // the divmod loop from the esolangs wiki, as the other passes
+  // leave it. a is the number of cells between n and d.
+  //   [->-[>+>>]>[+[-<+>]>+>>]<<<<<]      n d 0 0 0 0 => 0 d-n%d n%d n/d
+  //   [->+>-[>+>>]>[+[-<+>]>+>>]<<<<<<]   n 0 d 0 0 0 0 => 0 n d-n%d n%d n/d
+  if (code->op != OP_SKIPZ || code->a == 2 || code->b)
+    return INS(OP_NOP, 0, 0);
+  for (int k = 0; k < 2; k++) {
+    ins_t want[18];
+    int n = 0;
+    want[n++] = INS(OP_ADD, -1, 0);
+    if (k)
+      want[n++] = INS(OP_ADD, 1, 1);
+    want[n++] = INS(OP_SHIFT, 0, k + 1);
+    want[n++] = INS(OP_ADD, -1, 0);
+    want[n++] = INS(OP_SKIPZ, 0, 0);
+    want[n++] = INS(OP_ADD, 1, 1);
+    want[n++] = INS(OP_SHIFT, 0, 3);
+    want[n++] = INS(OP_LOOPNZ, 0, 0);
+    want[n++] = INS(OP_SHIFT, 0, 1);
+    want[n++] = INS(OP_SKIPZ, 0, 0);
+    want[n++] = INS(OP_LOAD, 1, 0);
+    want[n++] = INS(OP_SET, 0, 0);
+    want[n++] = INS(OP_ADDT, 1, -1);
+    want[n++] = INS(OP_ADD, 1, 1);
+    want[n++] = INS(OP_SHIFT, 0, 3);
+    want[n++] = INS(OP_LOOPNZ, 0, 0);
+    want[n++] = INS(OP_SHIFT, 0, -5 - k);
+    want[n++] = INS(OP_LOOPNZ, 0, 0);
+    if (match_ops(code, want, n))
+      return INS(OP_DIVMOD, k, code->b);
+  }
+  return INS(OP_NOP, 0, 0);
+}
+
+#define MAX_CARRY 7  // the most t holds
+
+ins_t carry_loop(ins_t *code) {
+  // counting a number of k cells, little-endian, up or down by one
+  // each iteration of the loop on c. the carries go through the two
+  // cells f and g just after the number, as bfcl.bf does it:
+  //   [ tmp = *n0 + s  *f += tmp  tmp += *g  *n0 = tmp  *g = 0
+  //     [ *f  *g += -1  *f = 0 } *f
+  //     *g += 1
+  //     [ *g  ... the same for n1 with g known to be one
+  //       ... up to nk-2
+  //       tmp = *g + 1  *nk-1 += tmp*s  *g = 0
+  //     } *g  ...
+  //     *c += -1 ] *c
+  // a cell carries into the next when it gets to zero, either way.
+  // t is k, and a the number's offset from c.
+  if (code->op != OP_SKIPZ || code->a == 2)
+    return INS(OP_NOP, 0, 0);
+  ins_t *load = next_op(code), *add = next_op(load);
+  int c = code->b, n0 = load->b, f = add->b, g = f + 1, k = f - n0, s = load->a;
+  if (load->op != OP_LOAD || (s != 1 && s != -1) || add->op != OP_ADDT ||
+      k < 2 || k > MAX_CARRY || (c >= n0 && c <= g) ||
+      n0 - c < INT8_MIN || n0 - c > INT8_MAX)
+    return INS(OP_NOP, 0, 0);
+  for (int swap = 0; swap < 2; swap++) {
+    ins_t want[13 * MAX_CARRY];
+    int n = 0;
+    want[n++] = INS(OP_LOAD, s, n0);
+    want[n++] = INS(OP_ADDT, 1, f);
+    want[n++] = INS(OP_TADD, 0, g);
+    want[n++] = INS(OP_SETT, 0, n0);
+    want[n++] = INS(OP_SET, 0, g);
+    want[n++] = INS(OP_SKIPZ, 0, f);
+    want[n++] = INS(OP_ADD, -1, g);
+    want[n++] = INS(OP_SET, 0, f);
+    want[n++] = INS(OP_LOOPNZ, 1, f);
+    for (int i = 1; i < k - 1; i++) {
+      want[n++] = INS(OP_ADD, 1, g);
+      want[n++] = INS(OP_SKIPZ, 0, g);
+      if (s > 0) {
+        // tmp = *ni  *f += tmp  *f += 1  tmp = *g  *ni += tmp
+        want[n++] = INS(OP_LOAD, 0, n0 + i);
+        want[n++] = INS(OP_ADDT, 1, f);
+        want[n++] = INS(OP_ADD, 1, f);
+        want[n++] = INS(OP_LOAD, 0, g);
+        want[n++] = INS(OP_ADDT, 1, n0 + i);
+      } else {
+        // tmp = *ni + -1  *f += tmp  tmp += *g -1  *ni = tmp
+        want[n++] = INS(OP_LOAD, -1, n0 + i);
+        want[n++] = INS(OP_ADDT, 1, f);
+        want[n++] = INS(OP_TADD, 0x7f, g);
+        want[n++] = INS(OP_SETT, 0, n0 + i);
+      }
+      want[n++] = INS(OP_SET, 0, g);
+      want[n++] = INS(OP_SKIPZ, 0, f);
+      want[n++] = INS(OP_ADD, -1, g);
+      want[n++] = INS(OP_SET, 0, f);
+      want[n++] = INS(OP_LOOPNZ, 1, f);
+    }
+    want[n++] = INS(OP_LOAD, 1, g);
+    want[n++] = swap ? INS(OP_SET, 0, g) : INS(OP_ADDT, s, f - 1);
+    want[n++] = swap ? INS(OP_ADDT, s, f - 1) : INS(OP_SET, 0, g);
+    for (int i = 1; i < k - 1; i++)
+      want[n++] = INS(OP_LOOPNZ, 1, g);
+    want[n++] = INS(OP_ADD, -1, c);
+    want[n++] = INS(OP_LOOPNZ, 0, c);
+    if (match_ops(code, want, n)) {
+      ins_t op = INS(s > 0 ? OP_CARRY : OP_BORROW, n0 - c, c);
+      op.t = k;
+      return op;
+    }
+  }
+  return INS(OP_NOP, 0, 0);
+}
+
+int compare_loop(ins_t *code, ins_buf_t *out) {
+  // the x < y compare from the esolangs wiki, when its two
+  // temporary cells are known to be zero. it appends the ops that
+  // do it before the loop:
+  //   x[ t0+ y[- t0[-] t1+ y] t0[- z+ t0] t1[- y+ t1] y- x- ]
+  //     => z += y < x  y -= x  x = 0
+  if (code->op != OP_SKIPZ || code->a == 2)
+    return 0;
+  ins_t *body[15], *ins = code;
+  for (int i = 0; i < 15; i++) {
+    if (ins->op == OP_EOF)
+      return 0;
+    body[i] = ins = next_op(ins);
+  }
+  int x = code->b, t0 = body[0]->b, y = body[1]->b, t1 = body[4]->b,
+      z = body[8]->b;
+  ins_t want[] = {
+    INS(OP_ADD, 1, t0),   INS(OP_SKIPZ, 0, y),  INS(OP_SET, 0, t0),
+    INS(OP_LOAD, 0, y),   INS(OP_ADDT, 1, t1),  INS(OP_SET, 0, y),
+    INS(OP_LOOPNZ, 1, y), INS(OP_LOAD, 0, t0),  INS(OP_ADDT, 1, z),
+    INS(OP_SET, 0, t0),   INS(OP_LOAD, -1, t1), INS(OP_SETT, 0, y),
+    INS(OP_SET, 0, t1),   INS(OP_ADD, -1, x),   INS(OP_LOOPNZ, 0, x),
+  };
+  int cells[] = {x, y, z, t0, t1};
+  for (int i = 0; i < 5; i++) {
+    for (int j = 0; j < i; j++) {
+      if (cells[i] == cells[j])
+        return 0;
+    }
+  }
+  if (!match_ops(code, want, 15) || !known_zero(code, t0) || !known_zero(code, t1))
+    return 0;
+  ins_t ops[] = {
+    INS(OP_LOAD, 0, y), INS(OP_CMP, 0, x), INS(OP_ADDT, 1, z),
+    INS(OP_LOAD, 0, x), INS(OP_ADDT, -1, y), INS(OP_SET, 0, x),
+  };
+  for (int i = 0; i < 6; i++) {
+    ops[i].t = body[3]->t;
+    append(out, ops[i]);
+  }
+  return 1;
+}
+
+ins_t cat_loop(ins_t *code) {
+  // loops that echo their input until a byte that makes the cell zero,
+  // with a the constant added after each read
+  //   [ *0 += -a print *0 *0 = read *0 += a ]
+  if (code->op != OP_SKIPZ || code->a == 2)
+    return INS(OP_NOP, 0, 0);
+  ins_t *body[4], *ins;
+  int n = 0, a = 0;
+  for (ins = code + 1; ins->op != OP_LOOPNZ; ++ins) {
+    if (ins->op == OP_NOP)
+      continue;
+    if (ins->op == OP_SKIPZ || n == 4 || ins->b != code->b)
+      return INS(OP_NOP, 0, 0);
+    body[n++] = ins;
+  }
+  if (ins->a || ins->b != code->b || n < 2)
+    return INS(OP_NOP, 0, 0);
+  // print and read, with an add before the print or after the read
+  int first = body[0]->op == OP_ADD, last = body[n - 1]->op == OP_ADD;
+  if (first + last + 2 != n || body[first]->op != OP_PRINT ||
+      body[first + 1]->op != OP_READ)
+    return INS(OP_NOP, 0, 0);
+  if (last)
+    a = body[n - 1]->a;
+  if ((int8_t)(first ? body[0]->a : 0) != (int8_t)-a)
+    return INS(OP_NOP, 0, 0);
+  return INS(OP_CAT, a, code->b);
+}
+
+ins_t* idioms(ins_t *code) {
+  // put an op in front of each loop that has a faster native version.
+  // it does what the loop would, as far as it can be sure of that,
+  // and leaves the cell zero so the loop is skipped.
+  // otherwise the loop after it runs as it is.
+  int len;
+  for (len = 0; code[len].op != OP_EOF; ++len) {}
+  ins_buf_t out = {malloc((len + 2) * sizeof(ins_t)), 1, len + 2};
+  assert(out.code);
+  out.code[0] = code[-1];
+
+  for (ins_t *ins = code; ins->op != OP_EOF; ++ins) {
+    ins_t op = divmod_loop(ins);
+    if (op.op == OP_NOP)
+      op = carry_loop(ins);
+    if (op.op == OP_NOP)
+      op = cat_loop(ins);
+    if (op.op != OP_NOP)
+      append(&out, op);
+    if (op.op != OP_NOP || compare_loop(ins, &out)) {
+      // the loop may now start with its cell zero
+      ins->a = 0;
+    }
+    append(&out, *ins);
+  }
+  append(&out, INS(OP_EOF, 0, 0));
+  free(code - 1);
+  return out.code + 1;
+}
@@ -0,0 +1,230 @@
+// Page allocation for the tape and generated code
+
+#define _GNU_SOURCE  // for memfd_create
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "beefit.h"
+
+static size_t round_size(size_t size, int huge) {
+  size_t page = huge ? HUGE_PAGE_SIZE : 4096;
+  return (size + page - 1) & ~(page - 1);
+}
+
+void *alloc_pages(size_t size, int huge) {
+  // zeroed, read/write pages. with huge set, try to back
+  // them with explicit huge pages, then transparent ones.
+  size = round_size(size, huge);
+  int flags = MAP_ANONYMOUS | MAP_PRIVATE;
+  if (!huge) {
+    void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    return mem == MAP_FAILED ? NULL : mem;
+  }
+
+  void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   flags | MAP_HUGETLB, -1, 0);
+  if (mem != MAP_FAILED) {
+    return mem;
+  }
+
+  // no reserved huge pages: map an aligned region and ask for THP,
+  // which silently falls back to small pages when unavailable.
+  uint8_t *raw = mmap(NULL, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                      flags, -1, 0);
+  if (raw == MAP_FAILED) {
+    return NULL;
+  }
+  uint8_t *aligned = (uint8_t *)(((uintptr_t)raw + HUGE_PAGE_SIZE - 1)
+                                 & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+  if (aligned > raw) {
+    munmap(raw, aligned - raw);
+  }
+  munmap(aligned + size, raw + HUGE_PAGE_SIZE - aligned);
+  madvise(aligned, size, MADV_HUGEPAGE);
+  return aligned;
+}
+
+void free_pages(void *mem, size_t size, int huge) {
+  munmap(mem, round_size(size, huge));
+}
+
+// compiled code is carved out of regions mapped twice from one memfd,
+// writable in one view and executable in the other, so nothing is
+// mapped or has its permissions changed per compile, and freed code
+// is reused. -T, -L and -P compile many small pieces.
+// once something doesn't fit, the region is retired: it takes no more
+// code, and its writable view goes as soon as the compiles still
+// writing to it are sealed, so only the newest region is ever writable.
+#define REGION_SIZE (1 << 20)
+#define CODE_ALIGN 64  // beyond what the emitter's .align asks for
+
+typedef struct region {
+  uint8_t *rx, *rw;  // rw is NULL once the region is retired and sealed
+  int writers;       // compiles given code here that aren't sealed yet
+  int retired;
+  struct region *next;
+} region_t;
+
+typedef struct block {
+  uint8_t *start;  // in the executable view
+  size_t size;
+  region_t *region;
+  struct block *next;
+} block_t;
+
+static region_t *regions;
+static block_t *free_blocks;  // by address
+static int no_regions;        // the system won't map them
+static pthread_mutex_t code_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void add_free(uint8_t *start, size_t size, region_t *region) {
+  // put a block back, merged with its neighbors in the same region
+  block_t *prev = NULL, *next = free_blocks;
+  while (next && next->start < start) {
+    prev = next;
+    next = next->next;
+  }
+  if (prev && prev->region == region && prev->start + prev->size == start) {
+    prev->size += size;
+    if (next && next->region == region && start + size == next->start) {
+      prev->size += next->size;
+      prev->next = next->next;
+      free(next);
+    }
+    return;
+  }
+  if (next && next->region == region && start + size == next->start) {
+    next->start = start;
+    next->size += size;
+    return;
+  }
+  block_t *block = malloc(sizeof(block_t));
+  if (!block)
+    return;  // the space is lost, but nothing breaks
+  *block = (block_t){start, size, region, next};
+  if (prev)
+    prev->next = block;
+  else
+    free_blocks = block;
+}
+
+static void retire_regions() {
+  // stop carving code out of the regions there are, and unmap the
+  // writable views nothing is being written through
+  while (free_blocks) {
+    block_t *next = free_blocks->next;
+    free(free_blocks);
+    free_blocks = next;
+  }
+  for (region_t *region = regions; region && !region->retired; region = region->next) {
+    region->retired = 1;
+    if (!region->writers) {
+      munmap(region->rw, REGION_SIZE);
+      region->rw = NULL;
+    }
+  }
+}
+
+static block_t **find_free(size_t size) {
+  // the first free block that's big enough, or the end of the list
+  block_t **at = &free_blocks;
+  while (*at && (*at)->size < size)
+    at = &(*at)->next;
+  return at;
+}
+
+static int new_region() {
+  int fd = memfd_create("beefit-code", MFD_CLOEXEC);
+  if (fd < 0)
+    return 0;
+  region_t *region = malloc(sizeof(region_t));
+  void *rw = MAP_FAILED, *rx = MAP_FAILED;
+  if (region && !ftruncate(fd, REGION_SIZE)) {
+    rw = mmap(NULL, REGION_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    rx = mmap(NULL, REGION_SIZE, PROT_READ | PROT_EXEC, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (!region || rw == MAP_FAILED || rx == MAP_FAILED) {
+    if (rw != MAP_FAILED)
+      munmap(rw, REGION_SIZE);
+    if (rx != MAP_FAILED)
+      munmap(rx, REGION_SIZE);
+    free(region);
+    return 0;
+  }
+  *region = (region_t){rx, rw, 0, 0, regions};
+  regions = region;
+  add_free(region->rx, REGION_SIZE, region);
+  return 1;
+}
+
+static region_t *find_region(void *code) {
+  for (region_t *region = regions; region; region = region->next) {
+    if ((uint8_t *)code >= region->rx && (uint8_t *)code < region->rx + REGION_SIZE)
+      return region;
+  }
+  return NULL;
+}
+
+void *alloc_code(size_t size, int huge, void **writable) {
+  // executable memory for size bytes of code, which are written
+  // through *writable before seal_code
+  size = (size + CODE_ALIGN - 1) & ~(size_t)(CODE_ALIGN - 1);
+  if (!huge && size <= REGION_SIZE / 2) {
+    pthread_mutex_lock(&code_lock);
+    block_t **at = find_free(size);
+    if (!*at && !no_regions) {
+      retire_regions();
+      if (new_region())
+        at = find_free(size);
+      else
+        no_regions = 1;
+    }
+    block_t *block = *at;
+    if (block) {
+      uint8_t *code = block->start;
+      *writable = block->region->rw + (code - block->region->rx);
+      block->region->writers++;
+      block->start += size;
+      block->size -= size;
+      if (!block->size) {
+        *at = block->next;
+        free(block);
+      }
+      pthread_mutex_unlock(&code_lock);
+      return code;
+    }
+    pthread_mutex_unlock(&code_lock);
+  }
+  // big code, or no regions: pages of its own, protected when sealed
+  void *mem = alloc_pages(size, huge);
+  *writable = mem;
+  return mem;
+}
+
+int seal_code(void *code, size_t size, int huge) {
+  pthread_mutex_lock(&code_lock);
+  region_t *region = find_region(code);
+  if (region && !--region->writers && region->retired) {
+    munmap(region->rw, REGION_SIZE);
+    region->rw = NULL;
+  }
+  pthread_mutex_unlock(&code_lock);
+  if (region)
+    return 0;
+  return mprotect(code, round_size(size, huge), PROT_EXEC | PROT_READ);
+}
+
+void free_code(void *code, size_t size, int huge) {
+  size = (size + CODE_ALIGN - 1) & ~(size_t)(CODE_ALIGN - 1);
+  pthread_mutex_lock(&code_lock);
+  region_t *region = find_region(code);
+  if (region && !region->retired)
+    add_free(code, size, region);
+  pthread_mutex_unlock(&code_lock);
+  if (!region)
+    free_pages(code, size, huge);
+}
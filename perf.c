@@ -0,0 +1,103 @@
+// Time and hardware performance counters around the JITed program, for -s
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "beefit.h"
+
+#define CACHE_MISS(cache) \
+  (PERF_COUNT_HW_CACHE_ ## cache | \
+   (PERF_COUNT_HW_CACHE_OP_READ << 8) | \
+   (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static struct {
+  char *name;
+  uint32_t type;
+  uint64_t config;
+  int fd;
+  uint64_t value;
+  int ok;
+} counters[] = {
+  {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1, 0, 0},
+  {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, -1, 0, 0},
+  {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, -1, 0, 0},
+  {"L1d-misses", PERF_TYPE_HW_CACHE, CACHE_MISS(L1D), -1, 0, 0},
+  {"LLC-misses", PERF_TYPE_HW_CACHE, CACHE_MISS(LL), -1, 0, 0},
+  {"dTLB-misses", PERF_TYPE_HW_CACHE, CACHE_MISS(DTLB), -1, 0, 0},
+  {"iTLB-misses", PERF_TYPE_HW_CACHE, CACHE_MISS(ITLB), -1, 0, 0},
+};
+
+enum { CYCLES, INSTRUCTIONS };  // for IPC
+
+#define NUM_COUNTERS (int)(sizeof(counters) / sizeof(counters[0]))
+
+static struct timespec start, end;
+
+void perf_begin() {
+  for (int i = 0; i < NUM_COUNTERS; i++) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = counters[i].type;
+    attr.config = counters[i].config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // there are more counters than most CPUs count at once, so the
+    // kernel takes turns, and the times let the counts be scaled up
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    counters[i].fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+  for (int i = 0; i < NUM_COUNTERS; i++) {
+    if (counters[i].fd >= 0) {
+      ioctl(counters[i].fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(counters[i].fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &start);
+}
+
+void perf_end() {
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  for (int i = 0; i < NUM_COUNTERS; i++) {
+    if (counters[i].fd < 0)
+      continue;
+    ioctl(counters[i].fd, PERF_EVENT_IOC_DISABLE, 0);
+    uint64_t values[3];  // the count, time enabled, time running
+    counters[i].ok = read(counters[i].fd, values, sizeof(values)) ==
+                     sizeof(values) && values[2];
+    if (counters[i].ok)
+      counters[i].value = values[0] * ((double)values[1] / values[2]);
+    close(counters[i].fd);
+    counters[i].fd = -1;
+  }
+}
+
+void perf_print() {
+  printf("time:%.1fms ", (end.tv_sec - start.tv_sec) * 1e3 +
+                         (end.tv_nsec - start.tv_nsec) / 1e6);
+  for (int i = 0; i < NUM_COUNTERS; i++) {
+    if (!counters[i].ok) {
+      printf("%s:n/a ", counters[i].name);
+    } else {
+      printf("%s:%llu ", counters[i].name,
+             (unsigned long long)counters[i].value);
+    }
+    if (i == INSTRUCTIONS) {
+      if (counters[CYCLES].ok && counters[INSTRUCTIONS].ok &&
+          counters[CYCLES].value) {
+        printf("IPC:%.2f ", (double)counters[INSTRUCTIONS].value /
+                            counters[CYCLES].value);
+      } else {
+        printf("IPC:n/a ");
+      }
+    }
+  }
+  printf("\n");
+}
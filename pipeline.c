@@ -0,0 +1,125 @@
+// Pipelined compilation for -P: while the main thread is still reading
+// the program, it hands off chunks of it, cut after top-level loops, to
+// threads that optimize and assemble each one on its own. the chunks
+// are then run in order, each starting where the last left PTR.
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "beefit.h"
+
+#define MAX_WORKERS 64
+
+typedef struct {
+  ins_t *code;
+  int opt_size, size;
+  bf_ptr fptr;
+} chunk_t;
+
+static chunk_t *chunks;
+static int num_chunks, limit, next_chunk, all_read;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t more = PTHREAD_COND_INITIALIZER;
+static pthread_t workers[MAX_WORKERS];
+static int num_workers;
+
+static void *worker(void *arg) {
+  (void)arg;
+  pthread_mutex_lock(&lock);
+  for (;;) {
+    while (next_chunk == num_chunks && !all_read)
+      pthread_cond_wait(&more, &lock);
+    if (next_chunk == num_chunks)
+      break;
+    int i = next_chunk++;
+    ins_t *code = chunks[i].code;
+    pthread_mutex_unlock(&lock);
+
+    int size = 0, opt_size = optimize(&code);
+    bf_ptr fptr = assemble(code, &size);
+
+    // chunks may have moved while this one was compiled
+    pthread_mutex_lock(&lock);
+    chunks[i] = (chunk_t){code, opt_size, size, fptr};
+  }
+  pthread_mutex_unlock(&lock);
+  return NULL;
+}
+
+void pipeline_start() {
+  // the main thread reads, so the rest of the cores compile
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  num_workers = cores > MAX_WORKERS ? MAX_WORKERS : cores > 1 ? cores - 1 : 1;
+  for (int i = 0; i < num_workers; ++i) {
+    if (pthread_create(&workers[i], NULL, worker, NULL)) {
+      perror("unable to start a compile thread");
+      exit(1);
+    }
+  }
+}
+
+static void add_chunk(ins_t *code, int n, int last) {
+  ins_t *copy = malloc((n + 2) * sizeof(ins_t));
+  if (!copy) {
+    perror("unable to allocate a chunk");
+    exit(1);
+  }
+  pthread_mutex_lock(&lock);
+  // all but the first chunk start in the middle of the program,
+  // and all but the last end there
+  copy[0] = INS(OP_EOF, (num_chunks ? MID_START : 0) | (last ? 0 : MID_END), 0);
+  memcpy(copy + 1, code, n * sizeof(ins_t));
+  copy[n + 1] = INS(OP_EOF, 0, 0);
+  if (num_chunks == limit) {
+    limit = limit ? limit * 2 : 16;
+    chunks = realloc(chunks, limit * sizeof(chunk_t));
+    if (!chunks) {
+      perror("unable to allocate a chunk");
+      exit(1);
+    }
+  }
+  chunks[num_chunks++] = (chunk_t){copy + 1, 0, 0, NULL};
+  all_read = last;
+  pthread_cond_broadcast(&more);
+  pthread_mutex_unlock(&lock);
+}
+
+void pipeline_chunk(ins_t *code, int n) {
+  add_chunk(code, n, 0);
+}
+
+static uint8_t *run_chunks(uint8_t *ptr, uint8_t *tape) {
+  for (int i = 0; i < num_chunks; ++i) {
+    if (chunks[i].fptr)
+      ptr = chunks[i].fptr(ptr, tape);
+    else
+      ptr = interpret(chunks[i].code, ptr, tape);
+  }
+  return ptr;
+}
+
+bf_ptr pipeline_finish(ins_t *code, int n, int *opt_size, int *size_out) {
+  // the rest of the program, then wait for every chunk
+  add_chunk(code, n, 1);
+  for (int i = 0; i < num_workers; ++i)
+    pthread_join(workers[i], NULL);
+
+  *opt_size = *size_out = 0;
+  for (int i = 0; i < num_chunks; ++i) {
+    *opt_size += chunks[i].opt_size;
+    *size_out += chunks[i].size;
+  }
+  return run_chunks;
+}
+
+void pipeline_release() {
+  for (int i = 0; i < num_chunks; ++i) {
+    if (chunks[i].fptr)
+      release(chunks[i].fptr, chunks[i].size);
+    free(chunks[i].code - 1);
+  }
+  free(chunks);
+}
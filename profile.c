@@ -0,0 +1,310 @@
+// Sampling profiler for -p: SIGPROF interrupts the program every
+// millisecond of CPU time, or every tick of the kernel's clock when
+// that's longer, and its handler notes where it was. the
+// emitter labels the code of each op, so afterwards each sample is
+// found in its block of code, and from there the op and the loops of
+// the source around it. loops that are compiled on their own, like
+// -L's, start a stack of their own.
+
+#define _GNU_SOURCE  // for REG_RIP
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <ucontext.h>
+
+#include "beefit.h"
+
+#define INTERVAL_US 1000
+#define MAX_SAMPLES (1 << 20)
+#define TOP_LOOPS 20
+#define SNIPPET 40
+
+static uintptr_t *samples;
+static volatile sig_atomic_t num_samples;
+static prof_block_t *blocks;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *grow(void *array, int n, size_t size) {
+  // room for element n, doubling at powers of two from 16
+  if (!n || (n >= 16 && !(n & (n - 1)))) {
+    array = realloc(array, (n ? n * 2 : 16) * size);
+    if (!array) {
+      perror("unable to allocate the profile");
+      exit(1);
+    }
+  }
+  return array;
+}
+
+prof_block_t *prof_block() {
+  prof_block_t *block = calloc(1, sizeof(prof_block_t));
+  if (!block) {
+    perror("unable to allocate the profile");
+    exit(1);
+  }
+  return block;
+}
+
+void prof_op(prof_block_t *block, uintptr_t label, uint32_t src, int loop) {
+  block->ops = grow(block->ops, block->num_ops, sizeof(prof_op_t));
+  block->ops[block->num_ops++] = (prof_op_t){label, src, loop};
+}
+
+int prof_loop(prof_block_t *block, uint32_t start, int parent) {
+  block->loops = grow(block->loops, block->num_loops, sizeof(prof_loop_t));
+  block->loops[block->num_loops] = (prof_loop_t){start, start, parent};
+  return block->num_loops++;
+}
+
+static int compare_addr(const void *a, const void *b) {
+  uintptr_t x = ((const prof_op_t *)a)->addr, y = ((const prof_op_t *)b)->addr;
+  return x < y ? -1 : x > y;
+}
+
+void prof_place(prof_block_t *block, void *code, size_t size) {
+  // the ops' addrs are set by now. the cold section comes after the
+  // rest, so they're sorted to be searched.
+  qsort(block->ops, block->num_ops, sizeof(prof_op_t), compare_addr);
+  block->start = (uintptr_t)code;
+  block->end = block->start + size;
+  block->hits = calloc(block->num_ops + 1, sizeof(int));
+  if (!block->hits) {
+    perror("unable to allocate the profile");
+    exit(1);
+  }
+  pthread_mutex_lock(&lock);
+  block->next = blocks;
+  blocks = block;
+  pthread_mutex_unlock(&lock);
+}
+
+void prof_free(prof_block_t *block) {
+  free(block->ops);
+  free(block->loops);
+  free(block->hits);
+  free(block);
+}
+
+static void on_sample(int sig, siginfo_t *info, void *context) {
+  (void)sig;
+  (void)info;
+  ucontext_t *uc = context;
+  if (num_samples < MAX_SAMPLES)
+    samples[num_samples++] = uc->uc_mcontext.gregs[REG_RIP];
+}
+
+void profile_start() {
+  samples = malloc(MAX_SAMPLES * sizeof(uintptr_t));
+  if (!samples) {
+    perror("unable to allocate the profile");
+    exit(1);
+  }
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_sigaction = on_sample;
+  action.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGPROF, &action, NULL);
+  struct itimerval timer = {{0, INTERVAL_US}, {0, INTERVAL_US}};
+  setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+void profile_stop() {
+  struct itimerval timer = {{0, 0}, {0, 0}};
+  setitimer(ITIMER_PROF, &timer, NULL);
+  signal(SIGPROF, SIG_IGN);
+}
+
+static int find(uintptr_t addr, prof_block_t **block) {
+  // the block addr is in, and 1 + the op whose code it's in: the
+  // last one labeled at or before it. 0 is the block's prologue,
+  // and -1 means it's not in any block.
+  for (*block = blocks; *block; *block = (*block)->next) {
+    if (addr >= (*block)->start && addr < (*block)->end)
+      break;
+  }
+  if (!*block)
+    return -1;
+  int lo = 0, hi = (*block)->num_ops;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if ((*block)->ops[mid].addr <= addr)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+typedef struct {
+  uint32_t start, end;  // start > end for the top level
+  int self, total;
+} row_t;
+
+typedef struct {
+  char *stack;
+  int count;
+} folded_t;
+
+static int compare_range(const void *a, const void *b) {
+  const row_t *x = a, *y = b;
+  if (x->start != y->start)
+    return x->start < y->start ? -1 : 1;
+  return x->end < y->end ? -1 : x->end > y->end;
+}
+
+static int compare_self(const void *a, const void *b) {
+  return ((const row_t *)b)->self - ((const row_t *)a)->self;
+}
+
+static int compare_stack(const void *a, const void *b) {
+  return strcmp(((const folded_t *)a)->stack, ((const folded_t *)b)->stack);
+}
+
+static char *stack_of(prof_block_t *block, prof_op_t *op, const char *name) {
+  // name;loop@start-end;...;@src, from the outermost loop in
+  int depth = 0, len = strlen(name) + 16;
+  for (int l = op->loop; l >= 0; l = block->loops[l].parent) {
+    depth++;
+    len += 32;
+  }
+  char *stack = malloc(len), *p = stack;
+  int *loops = malloc((depth + 1) * sizeof(int));
+  if (!stack || !loops) {
+    perror("unable to allocate the profile");
+    exit(1);
+  }
+  int i = depth;
+  for (int l = op->loop; l >= 0; l = block->loops[l].parent)
+    loops[--i] = l;
+  p += sprintf(p, "%s", name);
+  for (i = 0; i < depth; i++) {
+    prof_loop_t *loop = &block->loops[loops[i]];
+    p += sprintf(p, ";loop@%u-%u", loop->start, loop->end);
+  }
+  sprintf(p, ";@%u", op->src);
+  free(loops);
+  return stack;
+}
+
+static void print_snippet(FILE *out, const char *source, size_t len,
+                          uint32_t start, uint32_t end) {
+  // just the commands, as comments can be anything
+  int n = 0;
+  for (uint32_t i = start; i <= end && i < len; i++) {
+    if (!strchr("+-<>[].,", source[i]) || !source[i])
+      continue;
+    if (n++ == SNIPPET) {
+      fputs("...", out);
+      break;
+    }
+    fputc(source[i], out);
+  }
+}
+
+void profile_report(FILE *out, FILE *folded, const char *name,
+                    const char *source, size_t len) {
+  // -T's thread may still be adding blocks
+  pthread_mutex_lock(&lock);
+  int outside = 0, n = num_samples;
+  for (int i = 0; i < n; i++) {
+    prof_block_t *block;
+    int op = find(samples[i], &block);
+    if (op < 0)
+      outside++;
+    else
+      block->hits[op]++;
+  }
+  free(samples);
+
+  // a row per op with samples, for each loop around it and the top
+  row_t *rows = NULL;
+  folded_t *stacks = NULL;
+  int num_rows = 0, num_stacks = 0;
+  for (prof_block_t *block = blocks; block; block = block->next) {
+    for (int i = 0; i <= block->num_ops; i++) {
+      int hits = block->hits[i];
+      if (!hits)
+        continue;
+      prof_op_t prologue = {block->start, 0, -1};
+      prof_op_t *op = i ? &block->ops[i - 1] : &prologue;
+      if (!i && block->num_ops)
+        prologue.src = block->ops[0].src;
+      int self = 1;
+      for (int l = op->loop; ; l = block->loops[l].parent) {
+        rows = grow(rows, num_rows, sizeof(row_t));
+        row_t *row = &rows[num_rows++];
+        *row = l < 0 ? (row_t){1, 0, 0, hits} :
+            (row_t){block->loops[l].start, block->loops[l].end, 0, hits};
+        row->self = self ? hits : 0;
+        self = 0;
+        if (l < 0)
+          break;
+      }
+      stacks = grow(stacks, num_stacks, sizeof(folded_t));
+      stacks[num_stacks++] = (folded_t){stack_of(block, op, name), hits};
+    }
+  }
+
+  // the same loop can be in more than one block, or peeled into more
+  // than one loop, so rows and stacks are merged
+  qsort(rows, num_rows, sizeof(row_t), compare_range);
+  int m = 0;
+  for (int i = 0; i < num_rows; i++) {
+    if (m && !compare_range(&rows[m - 1], &rows[i])) {
+      rows[m - 1].self += rows[i].self;
+      rows[m - 1].total += rows[i].total;
+    } else {
+      rows[m++] = rows[i];
+    }
+  }
+  num_rows = m;
+  qsort(rows, num_rows, sizeof(row_t), compare_self);
+
+  fprintf(out, "profile: %d samples, %d outside the compiled code\n",
+          n, outside);
+  if (!blocks)
+    fprintf(out, "only the JIT's code is profiled, not -C's or -I's\n");
+  fprintf(out, " self%%  total%%  source\n");
+  for (int i = 0; i < num_rows && i < TOP_LOOPS; i++) {
+    fprintf(out, "%5.1f  %6.1f  ", 100.0 * rows[i].self / (n ? n : 1),
+            100.0 * rows[i].total / (n ? n : 1));
+    if (rows[i].start > rows[i].end) {
+      fprintf(out, "top level\n");
+      continue;
+    }
+    fprintf(out, "%u-%u ", rows[i].start, rows[i].end);
+    print_snippet(out, source, len, rows[i].start, rows[i].end);
+    fputc('\n', out);
+  }
+  free(rows);
+
+  if (folded) {
+    qsort(stacks, num_stacks, sizeof(folded_t), compare_stack);
+    for (int i = 0; i < num_stacks; i++) {
+      int count = stacks[i].count;
+      while (i + 1 < num_stacks && !compare_stack(&stacks[i], &stacks[i + 1])) {
+        free(stacks[i].stack);
+        count += stacks[++i].count;
+      }
+      fprintf(folded, "%s %d\n", stacks[i].stack, count);
+      free(stacks[i].stack);
+    }
+    if (outside)
+      fprintf(folded, "%s;[outside] %d\n", name, outside);
+  } else {
+    for (int i = 0; i < num_stacks; i++)
+      free(stacks[i].stack);
+  }
+  free(stacks);
+
+  while (blocks) {
+    prof_block_t *next = blocks->next;
+    prof_free(blocks);
+    blocks = next;
+  }
+  pthread_mutex_unlock(&lock);
+}
@@ -6,11 +6,17 @@ import sys
 import time
 
 
-def get_output(program, stdin):
+def get_output(program, stdin, flags):
     start = time.time()
-    p = subprocess.Popen(['./beefit', program] + sys.argv[1:],
-                         stdout=subprocess.PIPE, stdin=subprocess.PIPE)
-    output = p.communicate(input=stdin + '\x00')[0]
+    p = subprocess.Popen(['./beefit', program] + flags + sys.argv[1:],
+                         stdout=subprocess.PIPE, stdin=subprocess.PIPE,
+                         stderr=subprocess.PIPE)
+    output, errors = p.communicate(input=stdin + '\x00')
+    # a test that should fail has its error in the output
+    if p.returncode:
+        output += errors
+    else:
+        sys.stderr.write(errors)
     return output, time.time() - start
 
 
@@ -32,6 +38,20 @@ tests = [
     ('test/hanoi.bf',       '32cdfe329039'),
     ('test/hello.bf',       '2ef7bde608ce'),
     ('test/issue03.bf',     'da39a3ee5e6b'),
+    ('test/edge.bf',        'bc40a7b7f413', '', ['-b']),
+    ('test/peel.bf',        '9a49e0d91c1f'),
+    ('test/multiply.bf',    'a1bfa9a25648'),
+    ('test/steps.bf',       'de8380980f6c'),
+    ('test/counted.bf',     '8f14cb48d99d'),
+    ('test/balanced.bf',    '8a6ac426b0ce'),
+    ('test/temps.bf',       '0e72e9abbb28', '\x03\x01\x02\x03\x04\x08'),
+    ('test/vector.bf',      'e1d734db3f62', '\x07'),
+    ('test/move.bf',        'b6c5c286984c', 'hello world\n'),
+    ('test/runaway.bf',     '5bf2bf391a9e', '', ['-b']),
+    ('test/divmod.bf',      '769223decdd9', 'Az\x01\xff'),
+    ('test/carry.bf',       'f0589513aea4', '\xff\xff\x01\x30\x40\x05'),
+    ('test/compare.bf',     '15c05f7226ad', 'A9zz\x01\xff\xff\x01\x05\x06'),
+    ('test/cat.bf',         '14fa1d2feb86', 'first line\nsecond\nthird\n'),
     ('test/quine.bf',       '526e4d3d73ab'),
 ]
 
@@ -40,9 +60,10 @@ def run_tests():
         filename = test[0]
         expected_hash = test[1]
         stdin = test[2] if len(test) >= 3 else ''
+        flags = test[3] if len(test) >= 4 else []
         print filename.ljust(30),
         sys.stdout.flush()
-        output, elapsed = get_output(filename, stdin)
+        output, elapsed = get_output(filename, stdin, flags)
         actual_hash = hashlib.sha1(output).hexdigest()[:12]
         if actual_hash == expected_hash:
             print '\tGOOD\t%.1fms' % (elapsed * 1000)
@@ -0,0 +1,6 @@
+Loops that leave the pointer where it was are tested in place
+
+a loop on a neighbour right after another loop isn't dead
+++++++++[>++++++++<-]>[-]+++++++[>>+++++++++<<-]>>+.<<
+then a shift after a loop on the cell it shifts to stays outside of it
+>>>-<[[-]][<]>>>+++++++++.[-]<<+++++++++++.
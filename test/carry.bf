@@ -0,0 +1,40 @@
+A three byte number counted up and down by an input byte at a time
+the way bfcl uses for its sizes with the carries going through the
+two cells after the number
+
+,>,>,>>>,                             number then a byte to add
+[
+  <<<<<+[>>>+>+<<<<-]>>>>[<<<<+>>>>-] increase byte 1
+  <[>-<[-]]                           if no overflow set field to minus 1
+  >+[-                                if overflow
+     <<<+[>>+>+<<<-]>>>[<<<+>>>-]     increase byte 2
+     <[>-<[-]]
+     >+[<<+>>-]                       if overflow increase byte 3
+    ]
+  >-
+]
+<<<<<.>.>.
+>>>,                                  a byte to subtract
+[
+  <<<<<-[>>>+>+<<<<-]>>>>[<<<<+>>>>-] decrease byte 1
+  <[>-<[-]]                           if no underflow set field to minus 1
+  >+[-                                if underflow
+     <<<-[>>+>+<<<-]>>>[<<<+>>>-]     decrease byte 2
+     <[>-<[-]]
+     >+[-<<->>]                       if underflow decrease byte 3
+    ]
+  >-
+]
+<<<<<.>.>.
+>>+>,                                 again with the carry not clear
+[
+  <<<<<+[>>>+>+<<<<-]>>>>[<<<<+>>>>-]
+  <[>-<[-]]
+  >+[-
+     <<<+[>>+>+<<<-]>>>[<<<+>>>-]
+     <[>-<[-]]
+     >+[<<+>>-]
+    ]
+  >-
+]
+<<<<<.>.>.
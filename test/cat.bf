@@ -0,0 +1,7 @@
+Echo loops copy their input in bulk
+
+the first line without its newline
+,----------[++++++++++.,----------]
+then a colon and the rest up to a zero byte
+++++++++++[->++++++<]>--.[-]<
+,[.,]
@@ -0,0 +1,25 @@
+Whether the second of each pair of input bytes is less than the
+first with the compare from the esolangs wiki and what's left of it
+
+,[>,<
+  >>[-]>[-]>[-]<<<<
+  [>>+<[->[-]>+<<]>[->>+<<]>[-<<+>>]<<-<-]
+  >>>>>++++++[-<++++++++>]<.[-]
+  <<<.[-]<++++++++++.[-],
+]
+
+a run moved along the tape takes the cells cleared before it with it
+so the cells after it needn't be zero: 5 7 0 0 0 8 0 0 0 0
+>>>>>>>>>>>+++++>+++++++>>+++>++>>>+++++++++>+++++++++<<<<<<<<
+>>>>>[-]>[-]<<<<<<[[-<+>]>]>
+[>>>>+<<<[->>>[-]>+<<<<]>>>[-<<+>>]>[-<<<<+>>>>]<<<<-<-]<<<<
+++++++++++++++++++++++++++++++++++++++++++++++++.------------------------------------------------>
+++++++++++++++++++++++++++++++++++++++++++++++++.------------------------------------------------>
+++++++++++++++++++++++++++++++++++++++++++++++++.------------------------------------------------>
+++++++++++++++++++++++++++++++++++++++++++++++++.------------------------------------------------>
+++++++++++++++++++++++++++++++++++++++++++++++++.------------------------------------------------>
+++++++++++++++++++++++++++++++++++++++++++++++++.------------------------------------------------>
+++++++++++++++++++++++++++++++++++++++++++++++++.------------------------------------------------>
+++++++++++++++++++++++++++++++++++++++++++++++++.------------------------------------------------>
+++++++++++++++++++++++++++++++++++++++++++++++++.------------------------------------------------>
+++++++++++++++++++++++++++++++++++++++++++++++++.------------------------------------------------>
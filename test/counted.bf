@@ -0,0 +1,16 @@
+Loops that run a known number of times
+
+short ones are unrolled: 123456789:
+>++++++++++++++++++++++++++++++++++++++++++++++++<++++++++++[>+.<-]>[-]<
+
+longer ones are unrolled four or eight times: the alphabet on separate lines
+>>++++++++++<++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++<
+++++++++++++++++++++++++++[>+.>.<<-]>[-]>[-]<<
+
+and ones with loops inside count in registers: fifteen x (then a newline)
+>>++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++<<
++++++[>+++[>.<-]<-]>>[-]++++++++++.[-]<<
+
+even when both are long: three rows of a hundred dots
+>>++++++++++++++++++++++++++++++++++++++++++++++>++++++++++<<<
++++[>[-]++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++[>.<-]>>.<<<-]>>[-]>[-]<<<
@@ -0,0 +1,11 @@
+Each input byte in decimal with the divmod loop from the esolangs wiki
+
+,[
+  >++++++++++<[->-[>+>>]>[+[-<+>]>+>>]<<<<<]
+  units aside and the quotient back to divide again
+  >[-]>[->>>>+<<<<]>[-<<<+>>>]<<<
+  >++++++++++<[->-[>+>>]>[+[-<+>]>+>>]<<<<<]
+  >[-]>>>>>>++++++[-<++++++++<<<++++++++<++++++++>>>>>]
+  <<<<.<.>>>>.
+  [-]<<<<[-]>[-]<<<++++++++++.[-],
+]
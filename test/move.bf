@@ -0,0 +1,12 @@
+Loops that move a whole run of cells along the tape
+
+read a line after some room
+>>>>>>,[>,]<[<]
+seven before it gets added to the first cell as it moves
++++++++>
+[[-<+>]>]
+the line moved back by one and printed
+<<[<]>[.>]
+and moved forward by three
+<[[->>>+<<<]<]>>>>[.>]
+++++++++++.
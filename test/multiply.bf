@@ -0,0 +1,13 @@
+Nested loops that multiply cells together
+
+6 * 7 = 42 (*)
+++++++>+++++++<[->[->+>+<<]>>[-<<+>>]<<<]>>.>++++++++++.[-]<[-]<[-]<
+
+4 * 5 * 3 = 60 (less than)
+++++>+++++<[->[->+++>+<<]>>[-<<+>>]<<<]>>.[-]<[-]<
+
+the inner count grows each time so this is 1 plus 2 to 5 = 15 (question mark)
++++++[->+[->+>+<<]>>[-<<+>>]<<<]>>++++++++++++++++++++++++++++++++++++++++++++++++.[-]<[-]<
+
+squares: 9 * 9 = 81 (Q)
++++++++++[->+>+<<]>[->[->+>+<<]>>[-<<+>>]<<<]>>.>++++++++++.
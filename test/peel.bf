@@ -0,0 +1,5 @@
+peeling loops that are always entered
+the inner loop runs its body once before the loop
+and the scan after the first scan becomes an always entered loop
+++++++++[>++++++++<-]>+>++[[<.>-]]
++>+>+<<[>]<[<]>>>+++++++++.
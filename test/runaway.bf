@@ -0,0 +1,4 @@
+A loop that moves runs of cells walks off the start of the tape
+and the bounds check has to stop it there
+
++[<<<<<+>>>>>[[->+<]<]+]
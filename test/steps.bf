@@ -0,0 +1,16 @@
+Loops whose counter steps by more than one
+
+5 in steps of 3 runs 87 times: 87 (W)
++++++[--->+<]>.[-]<
+
+200 up in steps of 7 runs 8 times: 48 (0)
+>++++++[<++++++++++++++++++++++++++++++++>-]<++++++++[+++++++>++++++<]>.[-]<
+
+even steps need a known count: 10 in steps of 2 runs 5 times: 65 (A)
+++++++++++[-->+++++++++++++<]>.[-]<
+
+the counter goes down twice per iteration: 66 in steps of 2 (B)
+>++++++[<+++++++++++>-]<[->+<->+<]>.[-]<
+
+nested with a step of 3: 12 / 3 * 15 = 60 (less than) and a newline
+++++++++++++>+++++++++++++++<[--->[->+>+<<]>>[-<<+>>]<<<]>>.>++++++++++.
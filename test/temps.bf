@@ -0,0 +1,8 @@
+Four cells that a loop only reads stay loaded in four temporaries
+
+reads a count then four values then an even number
+,>,>,>,>,>>>>>>,<<<<<<<<<<[>>>>>>>>>[-]<<<<<<<<<>[-
+>>>>+>>>>+<<<<<<<<]>>>>>>>>[-<<<<<<<<+>>>>>>>>]<<<<<<<<<>>[-
+>>>>+>>>+<<<<<<<]>>>>>>>[-<<<<<<<+>>>>>>>]<<<<<<<<<>>>[-
+>>>>+>>+<<<<<<]>>>>>>[-<<<<<<+>>>>>>]<<<<<<<<<>>>>[->>>>+>+<<<<<]>>>>>[-
+<<<<<+>>>>>]<<<<<<<<<>>>>>>>>>>[-->+<]<<<<<<<<<<-]>>>>>.>.>.>.>>.
@@ -0,0 +1,13 @@
+Runs of updates to neighbouring cells are done in vector registers
+
+a row of constants
++++++++>++++++++>+++++++++>++++++++++>+++++++++++>++++++++++++>+++++++++++++>
+++++++++++++++>+++++++++++++++>++++++++++++++++<<<<<<<<<
+ten copies of an input cell with different factors added to the row
+>>>>>>>>>>>,
+[-<<<<<<<<<<<+>++>--->++++>+++++>++++++>+++++++>--------->+++>+>>]
+the row again plus 48 each and printed
+<<<<<<<<<<<[->+>+>+>+>+>+>+>+>+>+<<<<<<<<<<]
+++++++++[->++++++>++++++>++++++>++++++>++++++>++++++>++++++>++++++>++++++>++++++<<<<<<<<<<]
+>.>.>.>.>.>.>.>.>.>.
+[-]++++++++++.
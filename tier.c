@@ -0,0 +1,127 @@
+// Two tiers for -T: the program starts right away as baseline code,
+// only folded and condensed, while a thread optimizes and assembles
+// each loop on its own. the baseline polls a slot per loop at the
+// loop's back-edge, and once the slot is filled calls the optimized
+// loop to run the rest of it. PTR means the same in both, and no
+// temporaries are live there, so nothing else has to be carried over.
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "beefit.h"
+
+typedef struct {
+  int start, len;  // where the loop is in the baseline code
+  int parent;      // the loop around it, or -1
+  int done;
+} loop_t;
+
+static ins_t *baseline;  // the thread's own copy of the baseline code
+static loop_t *loops;
+static int *by_size;     // loop numbers, smallest loops first
+static int num_loops;
+static bf_ptr *entries;
+static int current;      // the loop the baseline entered last
+static pthread_t thread;
+static int running, stop;
+
+static int compare_size(const void *a, const void *b) {
+  return loops[*(const int *)a].len - loops[*(const int *)b].len;
+}
+
+static int next_loop(int *next_small) {
+  // the loop the baseline is in, or the nearest one around it that
+  // isn't done: that's where it's spending its time. otherwise the
+  // smallest loop left, as they're quick and usually the hottest.
+  int i = __atomic_load_n(&current, __ATOMIC_RELAXED);
+  for (; i >= 0; i = loops[i].parent) {
+    if (!loops[i].done)
+      return i;
+  }
+  while (*next_small < num_loops && loops[by_size[*next_small]].done)
+    ++*next_small;
+  return *next_small < num_loops ? by_size[*next_small] : -1;
+}
+
+static void *optimize_loops(void *arg) {
+  (void)arg;
+  // -p's samples are only of the program
+  sigset_t prof;
+  sigemptyset(&prof);
+  sigaddset(&prof, SIGPROF);
+  pthread_sigmask(SIG_BLOCK, &prof, NULL);
+  int i, next_small = 0;
+  while (!__atomic_load_n(&stop, __ATOMIC_RELAXED) &&
+         (i = next_loop(&next_small)) >= 0) {
+    loop_t *loop = &loops[i];
+    loop->done = 1;
+    ins_t *code = malloc((loop->len + 2) * sizeof(ins_t));
+    if (!code)
+      break;
+    // the optimizer mustn't take the loop for the program's start
+    code[0] = INS(OP_EOF, MID_START | MID_END, 0);
+    memcpy(code + 1, baseline + loop->start, loop->len * sizeof(ins_t));
+    code[loop->len + 1] = INS(OP_EOF, 0, 0);
+    code++;
+    optimize(&code);
+    int size;
+    bf_ptr fptr = assemble(code, &size);
+    free(code - 1);
+    if (!fptr)
+      break;
+    __atomic_store_n(&entries[i], fptr, __ATOMIC_RELEASE);
+  }
+  return NULL;
+}
+
+bf_ptr tier_start(ins_t *code, int *size_out) {
+  int len;
+  for (len = 0; code[len].op != OP_EOF; ++len) {}
+  baseline = malloc((len + 1) * sizeof(ins_t));
+  loops = malloc((len + 1) * sizeof(loop_t));
+  by_size = malloc((len + 1) * sizeof(int));
+  int *open = malloc((len + 1) * sizeof(int));
+  if (!baseline || !loops || !by_size || !open) {
+    perror("unable to allocate loops to optimize");
+    exit(1);
+  }
+  memcpy(baseline, code, len * sizeof(ins_t));
+
+  // loops are numbered by their starts, as the emitter does
+  int depth = 0;
+  for (int i = 0; i < len; ++i) {
+    if (code[i].op == OP_SKIPZ) {
+      int parent = depth ? open[depth - 1] : -1;
+      loops[num_loops] = (loop_t){i, 0, parent, 0};
+      by_size[num_loops] = num_loops;
+      open[depth++] = num_loops++;
+    } else if (code[i].op == OP_LOOPNZ) {
+      loop_t *loop = &loops[open[--depth]];
+      loop->len = i + 1 - loop->start;
+    }
+  }
+  free(open);
+  qsort(by_size, num_loops, sizeof(int), compare_size);
+
+  entries = calloc(num_loops + 1, sizeof(bf_ptr));
+  if (!entries) {
+    perror("unable to allocate loops to optimize");
+    exit(1);
+  }
+  current = -1;
+  bf_ptr fptr = assemble_tiered(code, entries, &current, size_out);
+  // without a thread, the baseline is all there is
+  running = fptr && !pthread_create(&thread, NULL, optimize_loops, NULL);
+  return fptr;
+}
+
+void tier_end() {
+  // the thread may be in the middle of a long loop, and nothing it
+  // does matters any more, so it's left to exit with the process
+  __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+  if (running)
+    pthread_detach(thread);
+}